@@ -0,0 +1,138 @@
+/* SHA-256 (FIPS 180-4) for the tidy result cache
+
+   See tidy.h for the copyright notice.
+
+*/
+
+#include <string.h>
+#include "sha256.h"
+
+#define ROTR(x, n)  ( ((x) >> (n)) | ((x) << (32 - (n))) )
+
+static const uint K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void sha256Block( TidySha256* ctx, const byte* p )
+{
+    uint w[64], a, b, c, d, e, f, g, h, t1, t2;
+    uint i;
+
+    for ( i = 0; i < 16; ++i, p += 4 )
+        w[i] = ((uint)p[0] << 24) | ((uint)p[1] << 16) |
+               ((uint)p[2] << 8) | p[3];
+    for ( ; i < 64; ++i )
+    {
+        uint s0 = ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18) ^ (w[i-15] >> 3);
+        uint s1 = ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = ( w[i-16] + s0 + w[i-7] + s1 ) & 0xffffffff;
+    }
+
+    a = ctx->state[0]; b = ctx->state[1];
+    c = ctx->state[2]; d = ctx->state[3];
+    e = ctx->state[4]; f = ctx->state[5];
+    g = ctx->state[6]; h = ctx->state[7];
+
+    for ( i = 0; i < 64; ++i )
+    {
+        t1 = h + ( ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25) ) +
+             ( (e & f) ^ (~e & g) ) + K[i] + w[i];
+        t2 = ( ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22) ) +
+             ( (a & b) ^ (a & c) ^ (b & c) );
+        h = g; g = f; f = e;
+        e = ( d + t1 ) & 0xffffffff;
+        d = c; c = b; b = a;
+        a = ( t1 + t2 ) & 0xffffffff;
+    }
+
+    ctx->state[0] = ( ctx->state[0] + a ) & 0xffffffff;
+    ctx->state[1] = ( ctx->state[1] + b ) & 0xffffffff;
+    ctx->state[2] = ( ctx->state[2] + c ) & 0xffffffff;
+    ctx->state[3] = ( ctx->state[3] + d ) & 0xffffffff;
+    ctx->state[4] = ( ctx->state[4] + e ) & 0xffffffff;
+    ctx->state[5] = ( ctx->state[5] + f ) & 0xffffffff;
+    ctx->state[6] = ( ctx->state[6] + g ) & 0xffffffff;
+    ctx->state[7] = ( ctx->state[7] + h ) & 0xffffffff;
+}
+
+void sha256Init( TidySha256* ctx )
+{
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+    ctx->count = ctx->countHi = 0;
+}
+
+void sha256Update( TidySha256* ctx, const void* data, size_t len )
+{
+    const byte* p = (const byte*) data;
+    uint used = ctx->count & 63;
+
+    while ( len > 0 )
+    {
+        uint n = 64 - used;
+        if ( n > len )
+            n = (uint) len;
+
+        memcpy( ctx->block + used, p, n );
+        ctx->count = ( ctx->count + n ) & 0xffffffff;
+        if ( ctx->count < n )
+            ++ctx->countHi;
+        used += n;
+        p += n;
+        len -= n;
+
+        if ( used == 64 )
+        {
+            sha256Block( ctx, ctx->block );
+            used = 0;
+        }
+    }
+}
+
+void sha256Final( TidySha256* ctx, byte digest[SHA256_SIZE] )
+{
+    uint used = ctx->count & 63;
+    uint hi = ( ctx->countHi << 3 ) | ( ctx->count >> 29 );
+    uint lo = ctx->count << 3;
+    uint i;
+
+    ctx->block[ used++ ] = 0x80;
+    if ( used > 56 )
+    {
+        memset( ctx->block + used, 0, 64 - used );
+        sha256Block( ctx, ctx->block );
+        used = 0;
+    }
+    memset( ctx->block + used, 0, 56 - used );
+    for ( i = 0; i < 4; ++i )
+    {
+        ctx->block[56 + i] = (byte)( hi >> (24 - 8 * i) );
+        ctx->block[60 + i] = (byte)( lo >> (24 - 8 * i) );
+    }
+    sha256Block( ctx, ctx->block );
+
+    for ( i = 0; i < 32; ++i )
+        digest[i] = (byte)( ctx->state[i / 4] >> (24 - 8 * (i % 4)) );
+}
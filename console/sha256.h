@@ -0,0 +1,26 @@
+#ifndef __TIDY_SHA256_H__
+#define __TIDY_SHA256_H__
+
+/* SHA-256 (FIPS 180-4) for the tidy result cache
+
+   See tidy.h for the copyright notice.
+
+*/
+
+#include "tidyplatform.h"
+
+#define SHA256_SIZE 32
+
+typedef struct _TidySha256
+{
+    uint   state[8];
+    uint   count;     /* bytes hashed, modulo 2^32 */
+    uint   countHi;   /* and the carries */
+    byte   block[64];
+} TidySha256;
+
+void sha256Init( TidySha256* ctx );
+void sha256Update( TidySha256* ctx, const void* data, size_t len );
+void sha256Final( TidySha256* ctx, byte digest[SHA256_SIZE] );
+
+#endif /* __TIDY_SHA256_H__ */
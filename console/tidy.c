@@ -9,6 +9,30 @@
 */
 
 #include "tidy.h"
+#include "tidybuffio.h"
+#include "sha256.h"
+#include <ctype.h>
+#include <time.h>
+#include <sys/stat.h>
+#if SUPPORT_THREADS
+#include <pthread.h>
+#endif
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#define fileno _fileno
+#else
+#define SUPPORT_SERVER_SOCKET 1
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 #if !defined(NDEBUG) && defined(_MSC_VER)
 #include "sprtf.h"
 #endif
@@ -165,6 +189,19 @@ static const CmdOptDesc cmdopt_defs[] =  {
     { "-modify",
       "modify the original input files",
       "write-back: yes", CmdOptFileManip, "-m" },
+    { "-jobs <n>",
+      "tidy the following files on <n> worker threads. Messages and "
+      "output still appear in input order.",
+      NULL, CmdOptFileManip, "-j <n>" },
+    { "-cache <dir>",
+      "keep the results of tidying files in <dir> and reuse "
+      "them for input tidied again with the same options. With -modify, "
+      "files that are tidy already are not rewritten.",
+      NULL, CmdOptFileManip },
+    { "-cache-limit <MB>",
+      "remove the results used longest ago once the cache holds more than "
+      "<MB> megabytes (default 256)",
+      NULL, CmdOptFileManip },
     { "-indent",
       "indent element content",
       "indent: auto", CmdOptProcDir, "-i" },
@@ -282,6 +319,10 @@ static const CmdOptDesc cmdopt_defs[] =  {
     { "-show-config",
       "list the current configuration settings",
       NULL, CmdOptMisc },
+    { "-serve [<socket>]",
+      "keep running and tidy the documents of length-prefixed requests "
+      "read from stdin, or from connections to the Unix domain <socket>",
+      NULL, CmdOptMisc },
     { NULL, NULL, NULL, CmdOptMisc }
 };
 
@@ -976,11 +1017,1114 @@ static void unknownOption( uint c )
     fprintf( errout, "HTML Tidy: unknown option: %c\n", (char)c );
 }
 
+/* Clean and check a document parsed with the given status.
+** Returns the status to go on with, negative if the document
+** should not be saved.
+*/
+static int cleanAndReport( TidyDoc tdoc, int status )
+{
+    if ( status >= 0 )
+        status = tidyCleanAndRepair( tdoc );
+
+    if ( status >= 0 ) {
+        status = tidyRunDiagnostics( tdoc );
+        if ( !tidyOptGetBool(tdoc, TidyQuiet) ) {
+            /* NOT quiet, show DOCTYPE, if not already shown */
+            if (!tidyOptGetBool(tdoc, TidyShowInfo)) {
+                tidyOptSetBool( tdoc, TidyShowInfo, yes );
+                tidyReportDoctype( tdoc );  /* FIX20140913: like warnings, errors, ALWAYS report DOCTYPE */
+                tidyOptSetBool( tdoc, TidyShowInfo, no );
+            }
+        }
+
+    }
+    if ( status > 1 ) /* If errors, do we want to force output? */
+        status = ( tidyOptGetBool(tdoc, TidyForceOutput) ? status : -1 );
+
+    return status;
+}
+
+/* Parse, clean and check one file, or stdin if htmlfil is NULL */
+static int tidyFile( TidyDoc tdoc, ctmbstr htmlfil )
+{
+    int status;
+
+    if ( htmlfil )
+    {
+        if ( tidyOptGetBool(tdoc, TidyEmacs) )
+            tidyOptSetValue( tdoc, TidyEmacsFile, htmlfil );
+        status = tidyParseFile( tdoc, htmlfil );
+    }
+    else
+        status = tidyParseStdin( tdoc );
+
+    return cleanAndReport( tdoc, status );
+}
+
+/*
+  Numbers and lengths in -cache files and -serve requests are 4 bytes,
+  most significant byte first.
+*/
+#define FRAME_CHUNK     0x10000     /* bytes read at a time */
+#define FRAME_MAX       0x10000000  /* longest -serve frame by default */
+
+static Bool readFrameLen( FILE* fin, uint* len )
+{
+    byte b[4];
+    if ( fread(b, 1, 4, fin) != 4 )
+        return no;
+    *len = ((uint)b[0] << 24) | ((uint)b[1] << 16) | ((uint)b[2] << 8) | b[3];
+    return yes;
+}
+
+/* Reads a length and that many bytes, failing for more than maxLen.
+** The bytes are read a chunk at a time, so that the buffer only grows
+** as far as they actually come.  There is room for a terminator after
+** them.  eof is set if there was nothing at all to read.
+*/
+static Bool readFrame( FILE* fin, TidyBuffer* buf, uint maxLen, Bool* eof )
+{
+    byte b[4];
+    size_t n = fread( b, 1, 4, fin );
+    uint len;
+
+    *eof = ( n == 0 && !ferror(fin) );
+    if ( n != 4 )
+        return no;
+    len = ((uint)b[0] << 24) | ((uint)b[1] << 16) | ((uint)b[2] << 8) | b[3];
+    if ( len > maxLen )
+        return no;
+
+    tidyBufClear( buf );
+    while ( buf->size < len )
+    {
+        uint chunk = len - buf->size < FRAME_CHUNK ? len - buf->size : FRAME_CHUNK;
+        tidyBufCheckAlloc( buf, buf->size + chunk + 1, 0 );
+        if ( fread(buf->bp + buf->size, 1, chunk, fin) != chunk )
+            return no;
+        buf->size += chunk;
+    }
+    tidyBufCheckAlloc( buf, len + 1, 0 );
+    return yes;
+}
+
+static void writeFrameLen( FILE* fout, uint len )
+{
+    byte b[4];
+    b[0] = (byte)(len >> 24);
+    b[1] = (byte)(len >> 16);
+    b[2] = (byte)(len >> 8);
+    b[3] = (byte) len;
+    fwrite( b, 1, 4, fout );
+}
+
+static void writeFrame( FILE* fout, TidyBuffer* buf )
+{
+    writeFrameLen( fout, buf->size );
+    if ( buf->size > 0 )
+        fwrite( buf->bp, 1, buf->size, fout );
+}
+
+/*
+  With -cache <dir> each tidied file leaves its result in <dir>, in a
+  file named by the SHA-256 of the options and the input bytes.  When
+  the same bytes are tidied with the same options again, the stored
+  markup and messages are written out and the file is not parsed.
+  After each run of files, the results used longest ago are removed
+  until the directory holds no more than -cache-limit <MB>.
+*/
+#define CACHE_MAGIC     "TidyCache1"
+#define CACHE_KEY_SIZE  (2 * SHA256_SIZE)
+
+typedef struct _TidyCache
+{
+    ctmbstr            dir;
+    unsigned long long limit;   /* in bytes */
+} TidyCache;
+
+typedef struct _TidyCacheEntry
+{
+    tmbchar            name[CACHE_KEY_SIZE + 1];
+    unsigned long long size;
+    time_t             used;
+} TidyCacheEntry;
+
+/* Returns "<dir>/<name>", to be freed by the caller */
+static tmbstr cachePath( TidyCache* cache, ctmbstr name )
+{
+    tmbstr path = (tmbstr) malloc( strlen(cache->dir) + strlen(name) + 2 );
+    if ( !path ) outOfMemory();
+    sprintf( path, "%s/%s", cache->dir, name );
+    return path;
+}
+
+static void TIDY_CALL putHashByte( void* sinkData, byte bt )
+{
+    sha256Update( (TidySha256*) sinkData, &bt, 1 );
+}
+
+/* The key covers the library version, every option that differs
+** from its default and the input bytes.
+*/
+static void cacheKey( TidyDoc tdoc, TidyBuffer* in,
+                      tmbchar key[CACHE_KEY_SIZE + 1] )
+{
+    ctmbstr version = tidyLibraryVersion();
+    TidySha256 sha;
+    TidyOutputSink sink;
+    byte digest[SHA256_SIZE];
+    uint ix;
+
+    sha256Init( &sha );
+    sha256Update( &sha, version, strlen(version) + 1 );
+    tidyInitSink( &sink, &sha, putHashByte );
+    tidyOptSaveSink( tdoc, &sink );
+    sha256Update( &sha, "", 1 );
+    sha256Update( &sha, in->bp, in->size );
+    sha256Final( &sha, digest );
+
+    for ( ix = 0; ix < SHA256_SIZE; ++ix )
+        sprintf( key + 2 * ix, "%02x", digest[ix] );
+}
+
+static Bool isCacheKey( ctmbstr name )
+{
+    uint ix;
+    for ( ix = 0; ix < CACHE_KEY_SIZE; ++ix )
+    {
+        if ( !isxdigit((byte) name[ix]) )
+            return no;
+    }
+    return name[ix] == '\0';
+}
+
+static void addCacheEntry( TidyCacheEntry** entries, uint* count, uint* size,
+                           ctmbstr name, unsigned long long bytes, time_t used )
+{
+    TidyCacheEntry* entry;
+
+    if ( !isCacheKey(name) )
+        return;
+    if ( *count == *size )
+    {
+        uint n = *size ? 2 * *size : 256;
+        TidyCacheEntry* more = (TidyCacheEntry*)
+            realloc( *entries, n * sizeof(TidyCacheEntry) );
+        if ( !more ) outOfMemory();
+        *entries = more;
+        *size = n;
+    }
+    entry = &(*entries)[ (*count)++ ];
+    strcpy( entry->name, name );
+    entry->size = bytes;
+    entry->used = used;
+}
+
+static int compareCacheEntries( const void* a, const void* b )
+{
+    time_t ua = ((const TidyCacheEntry*) a)->used;
+    time_t ub = ((const TidyCacheEntry*) b)->used;
+    return ua < ub ? -1 : ua > ub ? 1 : 0;
+}
+
+/* Removes the results used longest ago while the cache holds more
+** than its limit.  A result is used when it is stored or found.
+*/
+static void cacheTrim( TidyCache* cache )
+{
+    TidyCacheEntry* entries = NULL;
+    uint ix, count = 0, size = 0;
+    unsigned long long total = 0;
+#if defined(_WIN32)
+    struct _finddata_t found;
+    tmbstr pattern = cachePath( cache, "*" );
+    intptr_t find = _findfirst( pattern, &found );
+
+    if ( find != -1 )
+    {
+        do
+            addCacheEntry( &entries, &count, &size, found.name,
+                           (unsigned long long) found.size, found.time_write );
+        while ( _findnext(find, &found) == 0 );
+        _findclose( find );
+    }
+    free( pattern );
+#else
+    DIR* dir = opendir( cache->dir );
+    struct dirent* ent;
+
+    while ( dir && (ent = readdir(dir)) != NULL )
+    {
+        struct stat sbuf;
+        tmbstr path;
+
+        if ( !isCacheKey(ent->d_name) )
+            continue;
+        path = cachePath( cache, ent->d_name );
+        if ( stat(path, &sbuf) == 0 )
+            addCacheEntry( &entries, &count, &size, ent->d_name,
+                           (unsigned long long) sbuf.st_size, sbuf.st_mtime );
+        free( path );
+    }
+    if ( dir )
+        closedir( dir );
+#endif
+
+    for ( ix = 0; ix < count; ++ix )
+        total += entries[ix].size;
+    if ( total > cache->limit )
+    {
+        qsort( entries, count, sizeof(TidyCacheEntry), compareCacheEntries );
+        for ( ix = 0; ix < count && total > cache->limit; ++ix )
+        {
+            tmbstr path = cachePath( cache, entries[ix].name );
+            if ( remove(path) == 0 )
+                total -= entries[ix].size;
+            free( path );
+        }
+    }
+    free( entries );
+}
+
+static Bool readFile( ctmbstr filnam, TidyBuffer* buf )
+{
+    FILE* fin = fopen( filnam, "rb" );
+    Bool ok;
+
+    if ( !fin )
+        return no;
+    while ( !feof(fin) && !ferror(fin) )
+    {
+        tidyBufCheckAlloc( buf, buf->size + 16384, 0 );
+        buf->size += (uint) fread( buf->bp + buf->size, 1,
+                                   buf->allocated - buf->size, fin );
+    }
+    ok = !ferror( fin );
+    fclose( fin );
+    return ok;
+}
+
+static Bool writeFile( ctmbstr filnam, TidyBuffer* buf )
+{
+    FILE* fout = fopen( filnam, "wb" );
+    Bool ok;
+
+    if ( !fout )
+        return no;
+    ok = ( buf->size == 0 ||
+           fwrite(buf->bp, 1, buf->size, fout) == buf->size );
+    if ( fclose(fout) != 0 )
+        ok = no;
+    return ok;
+}
+
+/*
+  With -jobs <n> the input files are tidied on <n> worker threads.
+  Each file gets a document of its own, set up from a profile of the
+  options given before it on the command line.  Its messages and,
+  unless written back, its markup are collected in buffers, which
+  the main thread writes out in input order.
+*/
+typedef struct _TidyJob
+{
+    ctmbstr           htmlfil;
+    TidyConfigProfile profile;  /* shared with the neighbouring jobs */
+    TidyDoc           tdoc;
+    TidyBuffer        errbuf;
+    TidyBuffer        outbuf;
+    TidyBuffer        sumbuf;   /* error summary, with -cache */
+    int               status;
+    uint              seq;
+    uint              errors;   /* counts of a cached result */
+    uint              warnings;
+    uint              accessWarnings;
+    Bool              keyed;    /* looked up in the cache */
+    Bool              cached;   /* and found, tdoc is not parsed */
+    Bool              done;
+} TidyJob;
+
+typedef struct _TidyJobQueue
+{
+    TidyJob*          jobs;
+    uint              count;
+    uint              size;
+    uint              next;     /* next job for a worker */
+    uint              written;  /* jobs written out so far */
+    uint              window;   /* how far workers may run ahead */
+    TidyConfigProfile profile;  /* for files queued from now on */
+    TidyCache*        cache;
+    TidyBuffer        summary;  /* of the last job, if cached */
+#if SUPPORT_THREADS
+    pthread_mutex_t   lock;
+    pthread_cond_t    cond;
+#endif
+} TidyJobQueue;
+
+static void queueJob( TidyJobQueue* queue, TidyDoc tdoc, ctmbstr htmlfil )
+{
+    TidyJob* job;
+
+    if ( queue->count == queue->size )
+    {
+        uint size = queue->size ? 2 * queue->size : 64;
+        TidyJob* jobs = (TidyJob*) realloc( queue->jobs, size * sizeof(TidyJob) );
+        if ( !jobs ) outOfMemory();
+        queue->jobs = jobs;
+        queue->size = size;
+    }
+    if ( !queue->profile )
+        queue->profile = tidyCreateConfigProfile( tdoc );
+
+    job = &queue->jobs[ queue->count++ ];
+    memset( job, 0, sizeof(TidyJob) );
+    job->htmlfil = htmlfil;
+    job->profile = queue->profile;
+    job->seq = queue->count;
+}
+
+/* The longest frame that still fits in the rest of the file, so that
+** a damaged length is caught before anything is allocated for it.
+*/
+static uint cacheFrameMax( FILE* fin, const struct stat* sbuf )
+{
+    long pos = ftell( fin );
+    unsigned long long left;
+
+    if ( pos < 0 ||
+         (unsigned long long) sbuf->st_size < (unsigned long long) pos + 4 )
+        return 0;
+    left = (unsigned long long) sbuf->st_size - pos - 4;
+    return left < FRAME_MAX ? (uint) left : FRAME_MAX;
+}
+
+/* Marks a cached result as used now, for cacheTrim() */
+static void cacheTouch( ctmbstr path )
+{
+#if PRESERVE_FILE_TIMES
+    utime( path, NULL );
+#else
+    /* writing the first byte over itself updates the time as well */
+    FILE* fout = fopen( path, "r+b" );
+    if ( fout )
+    {
+        fputc( CACHE_MAGIC[0], fout );
+        fclose( fout );
+    }
+#endif
+}
+
+/* Fills in the job from the cached result for key */
+static Bool cacheLoad( TidyCache* cache, ctmbstr key, TidyJob* job )
+{
+    tmbstr path = cachePath( cache, key );
+    FILE* fin = fopen( path, "rb" );
+    char magic[ sizeof(CACHE_MAGIC) ];
+    struct stat sbuf;
+    uint status;
+    Bool eof, ok = no;
+
+    if ( fin )
+    {
+        ok = ( fstat(fileno(fin), &sbuf) == 0 &&
+               fread(magic, 1, sizeof(magic), fin) == sizeof(magic) &&
+               memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0 &&
+               readFrameLen(fin, &status) &&
+               readFrameLen(fin, &job->errors) &&
+               readFrameLen(fin, &job->warnings) &&
+               readFrameLen(fin, &job->accessWarnings) &&
+               readFrame(fin, &job->outbuf, cacheFrameMax(fin, &sbuf), &eof) &&
+               readFrame(fin, &job->errbuf, cacheFrameMax(fin, &sbuf), &eof) &&
+               readFrame(fin, &job->sumbuf, cacheFrameMax(fin, &sbuf), &eof) );
+        fclose( fin );
+    }
+    if ( ok )
+    {
+        job->status = (int) status;
+        cacheTouch( path );  /* used now */
+    }
+    else
+    {
+        tidyBufClear( &job->outbuf );
+        tidyBufClear( &job->errbuf );
+        tidyBufClear( &job->sumbuf );
+    }
+    free( path );
+    return ok;
+}
+
+/* Stores the job's result under key.  It is written to a file of its
+** own first, so that other jobs and processes never see half of it.
+*/
+static void cacheStore( TidyCache* cache, ctmbstr key, TidyDoc tdoc,
+                        TidyJob* job )
+{
+    tmbstr path = cachePath( cache, key );
+    tmbstr temp = (tmbstr) malloc( strlen(path) + 32 );
+    FILE* fout;
+
+    if ( !temp ) outOfMemory();
+    sprintf( temp, "%s.%d.%u.tmp", path, (int) getpid(), job->seq );
+
+    if ( (fout = fopen(temp, "wb")) != NULL )
+    {
+        Bool ok;
+
+        fwrite( CACHE_MAGIC, 1, sizeof(CACHE_MAGIC), fout );
+        writeFrameLen( fout, (uint) job->status );
+        writeFrameLen( fout, tidyErrorCount(tdoc) );
+        writeFrameLen( fout, tidyWarningCount(tdoc) );
+        writeFrameLen( fout, tidyAccessWarningCount(tdoc) );
+        writeFrame( fout, &job->outbuf );
+        writeFrame( fout, &job->errbuf );
+        writeFrame( fout, &job->sumbuf );
+
+        ok = !ferror( fout );
+        if ( fclose(fout) != 0 )
+            ok = no;
+        if ( !ok || rename(temp, path) != 0 )
+            remove( temp );
+    }
+    free( temp );
+    free( path );
+}
+
+/* Writes the tidied markup over the input file, unless that has the
+** same bytes already.  Returns no if the file could not be written.
+*/
+static Bool writeBackFile( TidyJob* job, TidyBuffer* in, Bool keepTime )
+{
+#if PRESERVE_FILE_TIMES
+    struct stat sbuf;
+    Bool restore;
+#endif
+    Bool ok;
+
+    if ( job->outbuf.size == in->size &&
+         ( in->size == 0 || memcmp(job->outbuf.bp, in->bp, in->size) == 0 ) )
+        return yes;
+
+#if PRESERVE_FILE_TIMES
+    restore = ( keepTime && stat(job->htmlfil, &sbuf) == 0 );
+#endif
+    ok = writeFile( job->htmlfil, &job->outbuf );
+#if PRESERVE_FILE_TIMES
+    if ( ok && restore )
+    {
+        /* set file last accessed/modified times to original values */
+        struct utimbuf filetimes;
+        filetimes.actime  = sbuf.st_atime;
+        filetimes.modtime = sbuf.st_mtime;
+        utime( job->htmlfil, &filetimes );
+    }
+#endif
+    return ok;
+}
+
+static void runJob( TidyJob* job, TidyCache* cache )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer inbuf;
+    tmbchar key[ CACHE_KEY_SIZE + 1 ];
+    Bool markup, writeBack;
+    int status;
+
+    tidyBufInit( &job->errbuf );
+    tidyBufInit( &job->outbuf );
+    tidyBufInit( &job->sumbuf );
+    tidyBufInit( &inbuf );
+
+    /* stderr takes the messages unencoded, an error file in the
+       output encoding, as in a run without -jobs */
+    if ( errout == stderr )
+    {
+        tidyOptSetValue( tdoc, TidyOutCharEncoding, "raw" );
+        tidySetErrorBuffer( tdoc, &job->errbuf );
+        tidyApplyConfigProfile( tdoc, job->profile );
+    }
+    else
+    {
+        tidyApplyConfigProfile( tdoc, job->profile );
+        tidySetErrorBuffer( tdoc, &job->errbuf );
+    }
+    markup = tidyOptGetBool( tdoc, TidyShowMarkup );
+    writeBack = tidyOptGetBool( tdoc, TidyWriteBack );
+
+    /* a file that cannot be read is left to tidyFile() to report */
+    if ( cache && readFile(job->htmlfil, &inbuf) )
+    {
+        if ( tidyOptGetBool(tdoc, TidyEmacs) )
+            tidyOptSetValue( tdoc, TidyEmacsFile, job->htmlfil );
+        cacheKey( tdoc, &inbuf, key );
+        job->keyed = yes;
+
+        if ( cacheLoad(cache, key, job) )
+        {
+            if ( job->status < 0 || !markup || !writeBack ||
+                 writeBackFile(job, &inbuf,
+                               tidyOptGetBool(tdoc, TidyKeepFileTimes)) )
+                job->cached = yes;
+            else
+            {
+                /* tidy it again to get the error reported */
+                tidyBufClear( &job->outbuf );
+                tidyBufClear( &job->errbuf );
+                tidyBufClear( &job->sumbuf );
+            }
+        }
+    }
+
+    if ( !job->cached )
+    {
+        if ( job->keyed )
+            status = cleanAndReport( tdoc, tidyParseBuffer(tdoc, &inbuf) );
+        else
+            status = tidyFile( tdoc, job->htmlfil );
+
+        if ( status >= 0 && markup )
+        {
+            /* an output file is written by writeJob(), in order */
+            if ( job->keyed )
+                status = tidySaveBuffer( tdoc, &job->outbuf );
+            else if ( writeBack )
+                status = tidySaveFile( tdoc, job->htmlfil );
+            else if ( !tidyOptGetValue(tdoc, TidyOutFile) )
+                status = tidySaveBuffer( tdoc, &job->outbuf );
+        }
+        job->status = status;
+
+        if ( job->keyed )
+        {
+            tidySetErrorBuffer( tdoc, &job->sumbuf );
+            tidyErrorSummary( tdoc );
+            cacheStore( cache, key, tdoc, job );
+
+            if ( status >= 0 && markup && writeBack &&
+                 !writeBackFile(job, &inbuf,
+                                tidyOptGetBool(tdoc, TidyKeepFileTimes)) )
+            {
+                tidySetErrorBuffer( tdoc, &job->errbuf );
+                job->status = tidySaveFile( tdoc, job->htmlfil );
+            }
+        }
+    }
+    tidyBufFree( &inbuf );
+    job->tdoc = tdoc;
+}
+
+#if SUPPORT_THREADS
+static void* jobThread( void* arg )
+{
+    TidyJobQueue* queue = (TidyJobQueue*) arg;
+
+    pthread_mutex_lock( &queue->lock );
+    for (;;)
+    {
+        TidyJob* job;
+
+        while ( queue->next < queue->count &&
+                queue->next >= queue->written + queue->window )
+            pthread_cond_wait( &queue->cond, &queue->lock );
+        if ( queue->next >= queue->count )
+            break;
+
+        job = &queue->jobs[ queue->next++ ];
+        pthread_mutex_unlock( &queue->lock );
+        runJob( job, queue->cache );
+        pthread_mutex_lock( &queue->lock );
+        job->done = yes;
+        pthread_cond_broadcast( &queue->cond );
+    }
+    pthread_mutex_unlock( &queue->lock );
+    return NULL;
+}
+#endif
+
+static void TIDY_CALL putErrByte( void* sinkData, byte bt )
+{
+    putc( bt, (FILE*) sinkData );
+}
+
+/* Writes out what the job produced.  Returns the job's document,
+** with its messages going to errout from now on.
+*/
+static TidyDoc writeJob( TidyJob* job )
+{
+    TidyDoc tdoc = job->tdoc;
+    ctmbstr outfil = tidyOptGetValue( tdoc, TidyOutFile );
+    Bool writeBack = tidyOptGetBool( tdoc, TidyWriteBack );
+    TidyOutputSink sink;
+
+    if ( job->errbuf.size > 0 )
+        fwrite( job->errbuf.bp, 1, job->errbuf.size, errout );
+    if ( job->outbuf.size > 0 && !writeBack && !outfil )
+        fwrite( job->outbuf.bp, 1, job->outbuf.size, stdout );
+    fflush( stdout );
+
+    tidyInitSink( &sink, errout, putErrByte );
+    tidySetErrorSink( tdoc, &sink );
+
+    if ( job->status >= 0 && tidyOptGetBool(tdoc, TidyShowMarkup) &&
+         !writeBack && outfil )
+    {
+        /* a cached result has no document to save */
+        if ( !job->keyed || !writeFile(outfil, &job->outbuf) )
+        {
+            if ( job->cached )
+                fprintf( errout, "Can't write \"%s\"\n", outfil );
+            else
+                tidySaveFile( tdoc, outfil );
+        }
+    }
+    tidyBufFree( &job->errbuf );
+    tidyBufFree( &job->outbuf );
+
+    fflush( errout );
+    return tdoc;
+}
+
+/* Tidies the queued files on up to nthreads threads, writes out the
+** results in order and adds up the counts.  Returns the document of
+** the last file for the summary, or NULL if nothing was queued.  If
+** the last result came from the cache, its summary is in the queue.
+*/
+static TidyDoc runJobs( TidyJobQueue* queue, uint nthreads,
+                        uint* contentErrors, uint* contentWarnings,
+                        uint* accessWarnings )
+{
+    TidyDoc last = NULL;
+    uint ix, started = 0;
+#if SUPPORT_THREADS
+    pthread_t* threads = (pthread_t*) malloc( nthreads * sizeof(pthread_t) );
+    if ( !threads ) outOfMemory();
+
+    pthread_mutex_init( &queue->lock, NULL );
+    pthread_cond_init( &queue->cond, NULL );
+    queue->window = 4 * nthreads;
+    for ( ix = 0; ix < nthreads && ix < queue->count; ++ix )
+    {
+        if ( pthread_create(&threads[started], NULL, jobThread, queue) == 0 )
+            ++started;
+    }
+#endif
+
+    for ( ix = 0; ix < queue->count; ++ix )
+    {
+        TidyJob* job = &queue->jobs[ ix ];
+
+#if SUPPORT_THREADS
+        if ( started > 0 )
+        {
+            pthread_mutex_lock( &queue->lock );
+            while ( !job->done )
+                pthread_cond_wait( &queue->cond, &queue->lock );
+            pthread_mutex_unlock( &queue->lock );
+        }
+        else
+#endif
+            runJob( job, queue->cache );
+
+        if ( last )
+            tidyRelease( last );
+        last = writeJob( job );
+
+        tidyBufFree( &queue->summary );
+        if ( job->cached )
+        {
+            *contentErrors   += job->errors;
+            *contentWarnings += job->warnings;
+            *accessWarnings  += job->accessWarnings;
+            queue->summary = job->sumbuf;
+        }
+        else
+        {
+            *contentErrors   += tidyErrorCount( last );
+            *contentWarnings += tidyWarningCount( last );
+            *accessWarnings  += tidyAccessWarningCount( last );
+            tidyBufFree( &job->sumbuf );
+        }
+
+        /* the jobs sharing a profile are next to each other */
+        if ( ix + 1 == queue->count || job[1].profile != job->profile )
+            tidyReleaseConfigProfile( job->profile );
+
+#if SUPPORT_THREADS
+        if ( started > 0 )
+        {
+            pthread_mutex_lock( &queue->lock );
+            queue->written = ix + 1;
+            pthread_cond_broadcast( &queue->cond );
+            pthread_mutex_unlock( &queue->lock );
+        }
+#endif
+    }
+
+#if SUPPORT_THREADS
+    for ( ix = 0; ix < started; ++ix )
+        pthread_join( threads[ix], NULL );
+    free( threads );
+    pthread_cond_destroy( &queue->cond );
+    pthread_mutex_destroy( &queue->lock );
+#endif
+
+    if ( queue->cache )
+        cacheTrim( queue->cache );
+
+    queue->count = queue->next = queue->written = 0;
+    queue->profile = NULL;
+    return last;
+}
+
+/*
+  With -serve [<socket>] tidy keeps running and tidies one document
+  per request, read from stdin or from connections to a Unix domain
+  socket.  All numbers are 4 bytes, most significant byte first.
+
+    request:  <n> options, <n> document bytes
+    response: <status> <n> output bytes, <n> message bytes
+
+  The options are "name: value" lines as in a config file, applied
+  over the options tidy was started with.  "config: <file>" loads a
+  config file; files are parsed once and kept until they change, and
+  problems with them are reported in the messages of the request that
+  found them.  Status is 0, 1 or 2 as the exit status of a run on the
+  document, or negative if the document could not be tidied.  A frame
+  longer than max-input-size, or 256 MB without it, is not read, and
+  ends the connection as a broken request would.  The server stops at
+  the end of its input.  Each connection keeps one document and its
+  buffers for all its requests.
+*/
+typedef struct _TidyConfigCache
+{
+    tmbstr                   cfgfil;
+    time_t                   mtime;
+    TidyConfigProfile        profile;
+    struct _TidyConfigCache* next;
+} TidyConfigCache;
+
+typedef struct _TidyServer
+{
+    TidyConfigProfile base;     /* the options given on the command line */
+    TidyConfigCache*  configs;  /* one per config file, latest version */
+    uint              maxFrame;
+#if SUPPORT_THREADS
+    pthread_mutex_t   lock;     /* for configs */
+#endif
+} TidyServer;
+
+/* Applies cfgfil to tdoc.  Each file is parsed once per version, over
+** the command line options, reporting to the messages of the request
+** that loaded it.  The profile is applied under the lock, as another
+** connection may replace it once the file changes.
+*/
+static void serverConfig( TidyServer* server, TidyDoc tdoc, ctmbstr cfgfil,
+                          TidyBuffer* msg )
+{
+    TidyConfigCache* cfg;
+    struct stat st;
+
+    if ( stat(cfgfil, &st) != 0 )
+    {
+        tidyLoadConfig( tdoc, cfgfil );  /* reports the failure */
+        return;
+    }
+
+#if SUPPORT_THREADS
+    pthread_mutex_lock( &server->lock );
+#endif
+    for ( cfg = server->configs; cfg; cfg = cfg->next )
+    {
+        if ( strcmp(cfg->cfgfil, cfgfil) == 0 )
+            break;
+    }
+
+    if ( !cfg || cfg->mtime != st.st_mtime )
+    {
+        TidyDoc tmp = tidyCreate();
+        tidySetErrorBuffer( tmp, msg );
+        tidyApplyConfigProfile( tmp, server->base );
+        if ( tidyLoadConfig(tmp, cfgfil) >= 0 )
+        {
+            if ( !cfg )
+            {
+                cfg = (TidyConfigCache*) malloc( sizeof(TidyConfigCache) );
+                if ( !cfg ) outOfMemory();
+                cfg->cfgfil = (tmbstr) malloc( strlen(cfgfil) + 1 );
+                if ( !cfg->cfgfil ) outOfMemory();
+                strcpy( cfg->cfgfil, cfgfil );
+                cfg->next = server->configs;
+                server->configs = cfg;
+            }
+            else
+                tidyReleaseConfigProfile( cfg->profile );
+            cfg->mtime = st.st_mtime;
+            cfg->profile = tidyCreateConfigProfile( tmp );
+        }
+        tidyRelease( tmp );
+    }
+
+    /* a version that failed to load leaves the last one unused */
+    if ( cfg && cfg->mtime == st.st_mtime )
+        tidyApplyConfigProfile( tdoc, cfg->profile );
+#if SUPPORT_THREADS
+    pthread_mutex_unlock( &server->lock );
+#endif
+}
+
+/* Applies the "name: value" lines of a request */
+static void serverOptions( TidyServer* server, TidyDoc tdoc, TidyBuffer* opts,
+                           TidyBuffer* msg )
+{
+    tmbstr line = (tmbstr) opts->bp, end = line + opts->size;
+
+    while ( line < end )
+    {
+        tmbstr eol = line, name, value;
+
+        while ( eol < end && *eol != '\n' )
+            ++eol;
+        *eol = '\0';  /* the buffer has room for it */
+
+        for ( name = line; *name == ' ' || *name == '\t'; ++name )
+            continue;
+        for ( value = name; *value && *value != ':' && *value != ' '; ++value )
+            continue;
+        if ( *value )
+        {
+            *value++ = '\0';
+            while ( *value == ':' || *value == ' ' || *value == '\t' )
+                ++value;
+        }
+        if ( *value )
+        {
+            tmbstr last = value + strlen(value) - 1;
+            while ( last > value && (*last == '\r' || *last == ' ' || *last == '\t') )
+                *last-- = '\0';
+        }
+
+        if ( *name == '\0' || *name == '#' )
+            ;
+        else if ( strcasecmp(name, "config") == 0 )
+            serverConfig( server, tdoc, value, msg );
+        else
+            tidyOptParseValue( tdoc, name, value );
+
+        line = eol + 1;
+    }
+}
+
+/* Answers requests until the end of fin.  Returns no on a broken
+** request or a failed write.
+*/
+static Bool serveStream( TidyServer* server, FILE* fin, FILE* fout )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer opts, in, out, msg;
+    Bool eof, ok = yes;
+
+    tidyBufInit( &opts );
+    tidyBufInit( &in );
+    tidyBufInit( &out );
+    tidyBufInit( &msg );
+
+    while ( ok )
+    {
+        int status;
+
+        if ( !readFrame(fin, &opts, server->maxFrame, &eof) )
+        {
+            ok = eof;  /* stopping between two requests is fine */
+            break;
+        }
+        if ( !readFrame(fin, &in, server->maxFrame, &eof) )
+        {
+            ok = no;
+            break;
+        }
+
+        tidyReset( tdoc );
+        tidyApplyConfigProfile( tdoc, server->base );
+        tidyBufClear( &out );
+        tidyBufClear( &msg );
+        tidySetErrorBuffer( tdoc, &msg );
+        serverOptions( server, tdoc, &opts, &msg );
+
+        status = tidyParseBuffer( tdoc, &in );
+        status = cleanAndReport( tdoc, status );
+        if ( status >= 0 && tidyOptGetBool(tdoc, TidyShowMarkup) )
+            status = tidySaveBuffer( tdoc, &out );
+        if ( status >= 0 || status == -1 )
+        {
+            status = tidyErrorCount(tdoc) > 0 ? 2 :
+                     tidyWarningCount(tdoc) > 0 ? 1 : 0;
+        }
+
+        writeFrameLen( fout, (uint) status );
+        writeFrame( fout, &out );
+        writeFrame( fout, &msg );
+        ok = ( fflush(fout) == 0 );
+    }
+
+    tidyBufFree( &opts );
+    tidyBufFree( &in );
+    tidyBufFree( &out );
+    tidyBufFree( &msg );
+    tidyRelease( tdoc );
+    return ok;
+}
+
+#if SUPPORT_SERVER_SOCKET
+typedef struct _TidyConnection
+{
+    TidyServer* server;
+    int         fd;
+} TidyConnection;
+
+static void* serveConnection( void* arg )
+{
+    TidyConnection* conn = (TidyConnection*) arg;
+    FILE* fin = fdopen( conn->fd, "rb" );
+    int fd = dup( conn->fd );
+    FILE* fout = fd >= 0 ? fdopen( fd, "wb" ) : NULL;
+
+    if ( fin && fout )
+        serveStream( conn->server, fin, fout );
+
+    if ( fout )
+        fclose( fout );
+    else if ( fd >= 0 )
+        close( fd );
+    if ( fin )
+        fclose( fin );
+    else
+        close( conn->fd );
+    free( conn );
+    return NULL;
+}
+
+/* Accepts connections on a Unix domain socket; returns on errors only */
+static Bool serveSocket( TidyServer* server, ctmbstr sockfil )
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if ( strlen(sockfil) >= sizeof(addr.sun_path) )
+    {
+        fprintf( errout, "Socket name \"%s\" is too long\n", sockfil );
+        return no;
+    }
+    memset( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, sockfil );
+
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    unlink( sockfil );
+    if ( fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+         listen(fd, 16) != 0 )
+    {
+        fprintf( errout, "Can't listen on \"%s\"\n", sockfil );
+        if ( fd >= 0 )
+            close( fd );
+        return no;
+    }
+
+    /* a client going away must not end the server */
+    signal( SIGPIPE, SIG_IGN );
+
+    for (;;)
+    {
+        TidyConnection* conn;
+        int cfd = accept( fd, NULL, NULL );
+
+        if ( cfd < 0 )
+        {
+            if ( errno == EINTR || errno == ECONNABORTED )
+                continue;
+            break;
+        }
+
+        conn = (TidyConnection*) malloc( sizeof(TidyConnection) );
+        if ( !conn ) outOfMemory();
+        conn->server = server;
+        conn->fd = cfd;
+#if SUPPORT_THREADS
+        {
+            pthread_t thread;
+            if ( pthread_create(&thread, NULL, serveConnection, conn) == 0 )
+            {
+                pthread_detach( thread );
+                continue;
+            }
+        }
+#endif
+        serveConnection( conn );
+    }
+
+    fprintf( errout, "Can't accept connections on \"%s\"\n", sockfil );
+    close( fd );
+    return no;
+}
+#endif /* SUPPORT_SERVER_SOCKET */
+
+/* Runs the server with the options of tdoc.  Returns the exit status */
+static int serve( TidyDoc tdoc, ctmbstr sockfil )
+{
+    TidyServer server;
+    TidyConfigCache* cfg;
+    Bool ok;
+
+    server.base = tidyCreateConfigProfile( tdoc );
+    server.configs = NULL;
+    server.maxFrame = tidyOptGetInt( tdoc, TidyMaxInputSize );
+    if ( server.maxFrame == 0 )
+        server.maxFrame = FRAME_MAX;
+#if SUPPORT_THREADS
+    pthread_mutex_init( &server.lock, NULL );
+#endif
+
+    if ( sockfil )
+    {
+#if SUPPORT_SERVER_SOCKET
+        ok = serveSocket( &server, sockfil );
+#else
+        fprintf( errout, "Sockets are not supported on this platform\n" );
+        ok = no;
+#endif
+    }
+    else
+    {
+#if defined(_WIN32)
+        _setmode( _fileno(stdin), _O_BINARY );
+        _setmode( _fileno(stdout), _O_BINARY );
+#endif
+        ok = serveStream( &server, stdin, stdout );
+        if ( !ok )
+            fprintf( errout, "Incomplete or oversized request, or failed write, stopping\n" );
+    }
+
+    while ( (cfg = server.configs) != NULL )
+    {
+        server.configs = cfg->next;
+        tidyReleaseConfigProfile( cfg->profile );
+        free( cfg->cfgfil );
+        free( cfg );
+    }
+#if SUPPORT_THREADS
+    pthread_mutex_destroy( &server.lock );
+#endif
+    tidyReleaseConfigProfile( server.base );
+    return ok ? 0 : 2;
+}
+
 int main( int argc, char** argv )
 {
     ctmbstr prog = argv[0];
-    ctmbstr cfgfil = NULL, errfil = NULL, htmlfil = NULL;
+    ctmbstr cfgfil = NULL, errfil = NULL, htmlfil = NULL, sockfil = NULL;
+    Bool serveMode = no;
     TidyDoc tdoc = tidyCreate();
+    TidyDoc summary = tdoc;
+    TidyJobQueue queue;
+    TidyCache cache;
+    uint jobs = 1;
     int status = 0;
 
     uint contentErrors = 0;
@@ -989,6 +2133,10 @@ int main( int argc, char** argv )
 
     errout = stderr;  /* initialize to stderr */
     status = 0;
+    memset( &queue, 0, sizeof(queue) );
+    tidyBufInit( &queue.summary );
+    cache.dir = NULL;
+    cache.limit = (unsigned long long) 256 << 20;
 #if !defined(NDEBUG) && defined(_MSC_VER)
     set_log_file((char *)"temptidy.txt", 0);
     // add_append_log(1);
@@ -1226,6 +2374,59 @@ int main( int argc, char** argv )
                 return 0;  /* success */
 
             }
+            else if ( strcasecmp(arg,  "serve") == 0 ||
+                      strcasecmp(arg, "-serve") == 0 )
+            {
+                serveMode = yes;
+                if ( argc >= 3 && argv[2][0] != '-' )
+                {
+                    sockfil = argv[2];
+                    --argc;
+                    ++argv;
+                }
+            }
+            else if ( strcasecmp(arg,  "jobs") == 0 ||
+                      strcasecmp(arg, "-jobs") == 0 ||
+                      strcasecmp(arg,     "j") == 0 )
+            {
+                if ( argc >= 3 )
+                {
+                    if ( sscanf( argv[2], "%u", &jobs ) > 0 )
+                    {
+                        --argc;
+                        ++argv;
+                    }
+                    if ( jobs == 0 )
+                        jobs = 1;
+                }
+            }
+            else if ( strcasecmp(arg,  "cache") == 0 ||
+                      strcasecmp(arg, "-cache") == 0 )
+            {
+                if ( argc >= 3 )
+                {
+                    cache.dir = argv[2];
+                    queue.cache = &cache;
+#if defined(_WIN32)
+                    _mkdir( cache.dir );
+#else
+                    mkdir( cache.dir, 0777 );
+#endif
+                    --argc;
+                    ++argv;
+                }
+            }
+            else if ( strcasecmp(arg,  "cache-limit") == 0 ||
+                      strcasecmp(arg, "-cache-limit") == 0 )
+            {
+                uint megabytes;
+                if ( argc >= 3 && sscanf(argv[2], "%u", &megabytes) > 0 )
+                {
+                    cache.limit = (unsigned long long) megabytes << 20;
+                    --argc;
+                    ++argv;
+                }
+            }
             else if ( strncmp(argv[1], "--", 2 ) == 0)
             {
                 if ( tidyOptParseValue(tdoc, argv[1]+2, argv[2]) )
@@ -1320,44 +2521,62 @@ int main( int argc, char** argv )
                 }
             }
 
+            /* files after this see the changed options */
+            queue.profile = NULL;
+
             --argc;
             ++argv;
             continue;
         }
 
+        if ( serveMode )
+        {
+            status = serve( tdoc, sockfil );
+            tidyRelease( tdoc );
+            return status;
+        }
+
+        /* the cache needs a document per file, as the jobs have */
+        if ( argc > 1 && (jobs > 1 || queue.cache) )
+        {
+            queueJob( &queue, tdoc, argv[1] );
+
+            --argc;
+            ++argv;
+
+            if ( argc <= 1 )
+                break;
+            continue;
+        }
+
+        /* keep the files in order */
+        if ( queue.count > 0 )
+        {
+            if ( summary != tdoc )
+                tidyRelease( summary );
+            summary = runJobs( &queue, jobs, &contentErrors,
+                               &contentWarnings, &accessWarnings );
+        }
+
         if ( argc > 1 )
         {
             htmlfil = argv[1];
 #if (!defined(NDEBUG) && defined(_MSC_VER))
             SPRTF("Tidying '%s'\n", htmlfil);
 #endif // DEBUG outout
-            if ( tidyOptGetBool(tdoc, TidyEmacs) )
-                tidyOptSetValue( tdoc, TidyEmacsFile, htmlfil );
-            status = tidyParseFile( tdoc, htmlfil );
+            status = tidyFile( tdoc, htmlfil );
         }
         else
         {
             htmlfil = "stdin";
-            status = tidyParseStdin( tdoc );
+            status = tidyFile( tdoc, NULL );
         }
 
-        if ( status >= 0 )
-            status = tidyCleanAndRepair( tdoc );
-
-        if ( status >= 0 ) {
-            status = tidyRunDiagnostics( tdoc );
-            if ( !tidyOptGetBool(tdoc, TidyQuiet) ) {
-                /* NOT quiet, show DOCTYPE, if not already shown */
-                if (!tidyOptGetBool(tdoc, TidyShowInfo)) {
-                    tidyOptSetBool( tdoc, TidyShowInfo, yes );
-                    tidyReportDoctype( tdoc );  /* FIX20140913: like warnings, errors, ALWAYS report DOCTYPE */
-                    tidyOptSetBool( tdoc, TidyShowInfo, no );
-                }
-            }
-
+        if ( summary != tdoc )
+        {
+            tidyRelease( summary );
+            summary = tdoc;
         }
-        if ( status > 1 ) /* If errors, do we want to force output? */
-            status = ( tidyOptGetBool(tdoc, TidyForceOutput) ? status : -1 );
 
         if ( status >= 0 && tidyOptGetBool(tdoc, TidyShowMarkup) )
         {
@@ -1392,18 +2611,35 @@ int main( int argc, char** argv )
             break;
     }
 
+    if ( queue.count > 0 )
+    {
+        if ( summary != tdoc )
+            tidyRelease( summary );
+        summary = runJobs( &queue, jobs, &contentErrors,
+                           &contentWarnings, &accessWarnings );
+    }
+    free( queue.jobs );
+
     if (!tidyOptGetBool(tdoc, TidyQuiet) &&
         errout == stderr && !contentErrors)
         fprintf(errout, "\n");
 
     if (contentErrors + contentWarnings > 0 && 
          !tidyOptGetBool(tdoc, TidyQuiet))
-        tidyErrorSummary(tdoc);
+    {
+        if ( summary != tdoc && queue.summary.size > 0 )
+            fwrite( queue.summary.bp, 1, queue.summary.size, errout );
+        else
+            tidyErrorSummary(summary);
+    }
+    tidyBufFree( &queue.summary );
 
     if (!tidyOptGetBool(tdoc, TidyQuiet))
-        tidyGeneralInfo(tdoc);
+        tidyGeneralInfo(summary);
 
     /* called to free hash tables etc. */
+    if ( summary != tdoc )
+        tidyRelease( summary );
     tidyRelease( tdoc );
 
     /* return status can be used by scripts */
@@ -96,6 +96,11 @@ opaque_type( TidyNode );
 */
 opaque_type( TidyAttr );
 
+/** @struct TidyConfigProfile
+**  Opaque, read-only set of option values
+*/
+opaque_type( TidyConfigProfile );
+
 /** @} end Opaque group */
 
 TIDY_STRUCT struct _TidyBuffer;
@@ -329,6 +334,13 @@ TIDY_EXPORT TidyDoc TIDY_CALL     tidyCreateWithAllocator( TidyAllocator *alloca
  */
 TIDY_EXPORT void TIDY_CALL        tidyRelease( TidyDoc tdoc );
 
+/** Drop the parsed document and the diagnostic counts so the TidyDoc
+ ** can be used for the next input, as if newly created but with the
+ ** current configuration and callbacks.  The lexer, print and hash
+ ** buffers keep their allocated size for the next document.
+ */
+TIDY_EXPORT void TIDY_CALL        tidyReset( TidyDoc tdoc );
+
 /** Let application store a chunk of data w/ each Tidy instance.
 **  Useful for callbacks.
 */
@@ -376,6 +388,30 @@ TIDY_EXPORT uint TIDY_CALL        tidyAccessWarningCount( TidyDoc tdoc );
 /** Number of Tidy configuration errors encountered. */
 TIDY_EXPORT uint TIDY_CALL        tidyConfigErrorCount( TidyDoc tdoc );
 
+/** Resource use for the current document.  Times are in microseconds
+**  and indexed by TidyPhase; they cover the last parse and everything
+**  done with the document since.  CPU time is process time, so other
+**  threads of the application count as well.  The tree figures are
+**  taken when tidyGetStats() is called.
+*/
+typedef struct _TidyStats
+{
+    unsigned long long wallTime[ N_TIDY_PHASES ];
+    unsigned long long cpuTime[ N_TIDY_PHASES ];
+    uint               nodes;       /**< Nodes in the tree, without the root */
+    uint               attributes;  /**< Attributes on those nodes */
+    uint               maxDepth;    /**< Deepest nesting, top level nodes are 1 */
+    uint               lexbufSize;  /**< Bytes allocated for the lexer buffer */
+    uint               printBufSize;/**< Bytes allocated for the print line */
+    unsigned long long allocCount;  /**< Calls to alloc and realloc */
+    unsigned long long allocBytes;  /**< Bytes asked for by those calls */
+} TidyStats;
+
+/** Fill in resource use statistics for the current document.
+**  Returns 0, or -EINVAL if stats is NULL.
+*/
+TIDY_EXPORT int TIDY_CALL         tidyGetStats( TidyDoc tdoc, TidyStats* stats );
+
 /* Get/Set configuration options
 */
 /** Load an ASCII Tidy configuration file */
@@ -511,6 +547,20 @@ TIDY_EXPORT Bool TIDY_CALL          tidyOptDiffThanSnapshot( TidyDoc tdoc );
 /** Copy current configuration settings from one document to another */
 TIDY_EXPORT Bool TIDY_CALL          tidyOptCopyConfig( TidyDoc tdocTo, TidyDoc tdocFrom );
 
+/** Freeze the current configuration settings of a document into a
+**  profile.  The profile does not change afterwards and can be applied
+**  to any number of documents, also from several threads.  It must be
+**  released with tidyReleaseConfigProfile() after its last use.
+*/
+TIDY_EXPORT TidyConfigProfile TIDY_CALL tidyCreateConfigProfile( TidyDoc tdoc );
+/** Set all configuration settings of a document from a profile,
+**  without parsing any option values.  Later changes to the document's
+**  settings do not affect the profile. */
+TIDY_EXPORT Bool TIDY_CALL          tidyApplyConfigProfile( TidyDoc tdoc,
+                                                        TidyConfigProfile profile );
+/** Free a profile made by tidyCreateConfigProfile() */
+TIDY_EXPORT void TIDY_CALL          tidyReleaseConfigProfile( TidyConfigProfile profile );
+
 /** Get character encoding name.  Used with TidyCharEncoding,
 **  TidyOutCharEncoding, TidyInCharEncoding */
 TIDY_EXPORT ctmbstr TIDY_CALL       tidyOptGetEncName( TidyDoc tdoc, TidyOptionId optId );
@@ -642,9 +692,48 @@ TIDY_EXPORT void TIDY_CALL tidyPutByte( TidyOutputSink* sink, uint byteValue );
 typedef Bool (TIDY_CALL *TidyReportFilter)( TidyDoc tdoc, TidyReportLevel lvl,
                                            uint line, uint col, ctmbstr mssg );
 
+/** Callback to filter messages given as the format and arguments
+**  of the message text, called after TidyReportFilter if both are
+**  set and only for the messages that filter kept.  Return true to
+**  proceed with output, false to cancel.  A message cancelled here
+**  is not formatted unless TidyReportFilter needed the text.
+*/
 typedef Bool (TIDY_CALL *TidyReportFilter2)( TidyDoc tdoc, TidyReportLevel lvl,
                                            uint line, uint col, ctmbstr mssg, va_list args );
 
+/** A diagnostic in structured form.  code is Tidy's internal message
+**  code.  The numbers are not part of the API and may change from one
+**  release to the next, so only compare them with codes seen from the
+**  same library, e.g. to count or suppress a kind of message.  tagId
+**  and attrId name the element and attribute concerned, or are
+**  TidyTag_UNKNOWN and TidyAttr_UNKNOWN.  line and column are 0 when
+**  unknown.
+**
+**  General messages have code 0 and no tag, attribute or position:
+**  configuration problems such as an unknown option or a bad option
+**  value, file errors, and the document version and summary lines.
+**  Messages that are not shown because of show-warnings, show-info,
+**  show-errors or show-repeats, and those after a resource limit was
+**  reached or the document was cancelled, never reach the filter.
+*/
+typedef struct _TidyMessageRecord
+{
+    uint            code;
+    TidyReportLevel level;
+    uint            line;
+    uint            column;
+    TidyTagId       tagId;
+    TidyAttrId      attrId;
+} TidyMessageRecord;
+
+/** Callback to receive diagnostics as records, before any message
+**  text is formatted.  Return true to go on with the other filters
+**  and the text output, false to drop the message.  A dropped
+**  message is never formatted.
+*/
+typedef Bool (TIDY_CALL *TidyReportRecordFilter)( TidyDoc tdoc,
+                                                 const TidyMessageRecord* rec );
+
 /** Give Tidy a filter callback to use */
 TIDY_EXPORT Bool TIDY_CALL    tidySetReportFilter( TidyDoc tdoc,
                                                   TidyReportFilter filtCallback );
@@ -652,6 +741,9 @@ TIDY_EXPORT Bool TIDY_CALL    tidySetReportFilter( TidyDoc tdoc,
 TIDY_EXPORT Bool TIDY_CALL    tidySetReportFilter2( TidyDoc tdoc,
                                                   TidyReportFilter2 filtCallback );
 
+TIDY_EXPORT Bool TIDY_CALL    tidySetReportRecordFilter( TidyDoc tdoc,
+                                                  TidyReportRecordFilter filtCallback );
+
 /** Set error sink to named file */
 TIDY_EXPORT FILE* TIDY_CALL   tidySetErrorFile( TidyDoc tdoc, ctmbstr errfilnam );
 /** Set error sink to given buffer */
@@ -671,6 +763,19 @@ typedef void (TIDY_CALL *TidyPPProgress)( TidyDoc tdoc, uint line, uint col, uin
 TIDY_EXPORT Bool TIDY_CALL   tidySetPrettyPrinterCallback( TidyDoc tdoc,
                                                   TidyPPProgress callback );
 
+/** Callback polled while parsing, cleaning and printing.  Return yes
+**  to stop: the current phase winds down, leaving a releasable
+**  document, and it and all later phases return -ECANCELED.
+*/
+typedef Bool (TIDY_CALL *TidyCancelCallback)( TidyDoc tdoc );
+
+/** Set the cancel callback, called once every interval tokens read or
+**  nodes visited, or NULL for none.  A new parse clears a cancel.
+*/
+TIDY_EXPORT Bool TIDY_CALL   tidySetCancelCallback( TidyDoc tdoc,
+                                                   TidyCancelCallback callback,
+                                                   uint interval );
+
 /** @} end IO group */
 
 /* TODO: Catalog all messages for easy translation
@@ -702,6 +807,39 @@ TIDY_EXPORT int TIDY_CALL         tidyParseBuffer( TidyDoc tdoc, TidyBuffer* buf
 /** Parse markup in given generic input source */
 TIDY_EXPORT int TIDY_CALL         tidyParseSource( TidyDoc tdoc, TidyInputSource* source);
 
+/** Parse markup in given string as the content of an element of the
+**  given type, e.g. TidyTag_DIV or TidyTag_TD, without inferring the
+**  html, head and body elements or checking the doctype.  Elements
+**  only allowed in the head are dropped.  Saving the document then
+**  writes just the fragment.  Returns -EINVAL for a context that
+**  cannot have content, or is html, head or frameset.
+*/
+TIDY_EXPORT int TIDY_CALL         tidyParseFragment( TidyDoc tdoc, ctmbstr content,
+                                                     TidyTagId context );
+
+/** Callback receiving the tokens read by tidyTokenize*(): start, end
+**  and empty tags with their tag and attribute ids resolved, text with
+**  entities decoded, comments, doctypes and the like.  The node and
+**  its attributes are only valid during the call.  Return no to stop
+**  reading.
+*/
+typedef Bool (TIDY_CALL *TidyTokenCallback)( TidyDoc tdoc, TidyNode tnod );
+
+/** Read markup in given string token by token, passing each token to
+**  the callback as it is read.  No tree is built, the document stays
+**  empty.  Returns the status of a parse of the same markup.
+*/
+TIDY_EXPORT int TIDY_CALL         tidyTokenizeString( TidyDoc tdoc, ctmbstr content,
+                                                      TidyTokenCallback callback );
+
+/** Read markup in given buffer token by token */
+TIDY_EXPORT int TIDY_CALL         tidyTokenizeBuffer( TidyDoc tdoc, TidyBuffer* buf,
+                                                      TidyTokenCallback callback );
+
+/** Read markup in given generic input source token by token */
+TIDY_EXPORT int TIDY_CALL         tidyTokenizeSource( TidyDoc tdoc, TidyInputSource* source,
+                                                      TidyTokenCallback callback );
+
 /** @} End Parse group */
 
 
@@ -748,6 +886,29 @@ TIDY_EXPORT int TIDY_CALL         tidySaveString( TidyDoc tdoc,
 /** Save to given generic output sink */
 TIDY_EXPORT int TIDY_CALL         tidySaveSink( TidyDoc tdoc, TidyOutputSink* sink );
 
+/** Save document to a buffer allocated by Tidy.  The document is
+**  rendered once, into a buffer grown as needed, which is then handed
+**  over to the caller without copying.  On success *buffer points to
+**  the output, followed by a NUL byte, and *buflen holds its size
+**  (without the NUL).  The memory comes from the document's allocator;
+**  release it with tidyReleaseSaved().
+*/
+TIDY_EXPORT int TIDY_CALL         tidySaveAllocated( TidyDoc tdoc,
+                                                    tmbstr* buffer, uint* buflen );
+
+/** Release a buffer returned by tidySaveAllocated().  Pass the
+**  allocator the document was created with, or NULL for the default
+**  allocator.  The document itself may already have been released.
+*/
+TIDY_EXPORT void TIDY_CALL        tidyReleaseSaved( TidyAllocator* allocator,
+                                                   tmbstr buffer );
+
+/** Compute the size in bytes tidySaveString() and friends would
+**  produce, without keeping any of the output.  Useful to size an
+**  application buffer up front.
+*/
+TIDY_EXPORT int TIDY_CALL         tidySaveMeasure( TidyDoc tdoc, uint* buflen );
+
 /** @} end Save group */
 
 
@@ -841,6 +1002,15 @@ TIDY_EXPORT TidyNode TIDY_CALL    tidyGetBody( TidyDoc tdoc );
 /* remove a node */
 TIDY_EXPORT TidyNode TIDY_CALL    tidyDiscardElement( TidyDoc tdoc, TidyNode tnod );
 
+/** Iterate over the elements with the given tag id, in document order.
+**  The tree is indexed on the first call, so that later calls take
+**  time in proportion to the elements found.  Cleaning, saving,
+**  discarding an element or a new parse end running iterations.
+*/
+TIDY_EXPORT TidyIterator TIDY_CALL tidyGetNodesByTagId( TidyDoc tdoc, TidyTagId tid );
+/** Get next element with the tag id of tidyGetNodesByTagId() */
+TIDY_EXPORT TidyNode TIDY_CALL    tidyGetNextNodeByTagId( TidyDoc tdoc, TidyIterator* pos );
+
 /* parent / child */
 TIDY_EXPORT TidyNode TIDY_CALL    tidyGetParent( TidyNode tnod );
 TIDY_EXPORT TidyNode TIDY_CALL    tidyGetChild( TidyNode tnod );
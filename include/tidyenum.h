@@ -206,6 +206,13 @@ typedef enum
   TidyAnchorAsName,    /**< Define anchors as name attributes */
   TidyPPrintTabs,       /**< Indent using tabs istead of spaces */
   TidySkipNested,      /**< Skip nested tags in script and style CDATA */
+  TidyPrintThreads,    /**< Number of threads used to print the body */
+  TidyMinify,          /**< Output as compact as possible */
+  TidyShowRepeats,     /**< Number of messages with the same code to put out */
+  TidyMaxInputSize,    /**< Stop parsing after this many bytes of input */
+  TidyMaxNodes,        /**< Stop parsing after creating this many nodes */
+  TidyMaxDepth,        /**< Stop parsing at this element nesting depth */
+  TidyMaxAttributes,   /**< Stop parsing at this many attributes on an element */
   N_TIDY_OPTIONS       /**< Must be last */
 } TidyOptionId;
 
@@ -815,6 +822,19 @@ typedef enum
   N_TIDY_ATTRIBS              /**< Must be last */
 } TidyAttrId;
 
+/** Processing phases timed by tidyGetStats()
+*/
+typedef enum
+{
+  TidyPhase_Parse,            /**< Decoding, lexing and building the tree */
+  TidyPhase_AttrChecks,       /**< Attribute checks after parsing */
+  TidyPhase_Access,           /**< Accessibility checks */
+  TidyPhase_CleanRepair,      /**< tidyCleanAndRepair() */
+  TidyPhase_Diagnostics,      /**< tidyRunDiagnostics() */
+  TidyPhase_Print,            /**< Pretty printing and encoding output */
+  N_TIDY_PHASES               /**< Must be last */
+} TidyPhase;
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
@@ -60,6 +60,13 @@ extern "C" {
 #define SUPPORT_ACCESSIBILITY_CHECKS 1
 #endif
 
+/* Enable/disable use of POSIX threads, e.g. by the print-threads option.
+** Off unless the build system has found a usable pthreads library.
+*/
+#ifndef SUPPORT_THREADS
+#define SUPPORT_THREADS 0
+#endif
+
 
 /* Convenience defines for Mac platforms */
 
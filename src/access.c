@@ -366,7 +366,12 @@ static ctmbstr textFromOneNode( TidyDocImpl* doc, Node* node )
     uint i;
     uint x = 0;
     tmbstr txt = doc->access.text;
-    
+
+    /* Several checks of a node look at the same text */
+    if ( node && node == doc->access.textFrom )
+        return txt;
+    doc->access.textFrom = node;
+
     if ( node )
     {
         /* Copy contents of a text node */
@@ -1035,48 +1040,6 @@ static void CheckObject( TidyDocImpl* doc, Node* node )
 }
 
 
-/***************************************************************
-* CheckMissingStyleSheets
-*
-* Ensures that stylesheets are used to control the presentation.
-***************************************************************/
-
-static Bool CheckMissingStyleSheets( TidyDocImpl* doc, Node* node )
-{
-    AttVal* av;
-    Node* content;
-    Bool sspresent = no;
-
-    for ( content = node->content;
-          !sspresent && content != NULL;
-          content = content->next )
-    {
-        sspresent = ( nodeIsLINK(content)  ||
-                      nodeIsSTYLE(content) ||
-                      nodeIsFONT(content)  ||
-                      nodeIsBASEFONT(content) );
-
-        for ( av = content->attributes;
-              !sspresent && av != NULL;
-              av = av->next )
-        {
-            sspresent = ( attrIsSTYLE(av) || attrIsTEXT(av)  ||
-                          attrIsVLINK(av) || attrIsALINK(av) ||
-                          attrIsLINK(av) );
-
-            if ( !sspresent && attrIsREL(av) )
-            {
-                sspresent = AttrValueIs(av, "stylesheet");
-            }
-        }
-
-        if ( ! sspresent )
-            sspresent = CheckMissingStyleSheets( doc, content );
-    }
-    return sspresent;
-}
-
-
 /*******************************************************************
 * CheckFrame
 *
@@ -2600,90 +2563,6 @@ static void CheckDeprecated( TidyDocImpl* doc, Node* node )
 }
 
 
-/************************************************************
-* CheckScriptKeyboardAccessible
-*
-* Elements must have a device independent event handler if 
-* they have any of the following device dependent event 
-* handlers. 
-************************************************************/
-
-static void CheckScriptKeyboardAccessible( TidyDocImpl* doc, Node* node )
-{
-    Node* content;
-    int HasOnMouseDown = 0;
-    int HasOnMouseUp = 0;
-    int HasOnClick = 0;
-    int HasOnMouseOut = 0;
-    int HasOnMouseOver = 0;
-    int HasOnMouseMove = 0;
-
-    if (Level2_Enabled( doc ))
-    {
-        AttVal* av;
-        /* Checks all elements for their attributes */
-        for (av = node->attributes; av != NULL; av = av->next)
-        {
-            /* Must also have 'ONKEYDOWN' attribute with 'ONMOUSEDOWN' */
-            if ( attrIsOnMOUSEDOWN(av) )
-                HasOnMouseDown++;
-
-            /* Must also have 'ONKEYUP' attribute with 'ONMOUSEUP' */
-            if ( attrIsOnMOUSEUP(av) )
-                HasOnMouseUp++;
-
-            /* Must also have 'ONKEYPRESS' attribute with 'ONCLICK' */
-            if ( attrIsOnCLICK(av) )
-                HasOnClick++;
-
-            /* Must also have 'ONBLUR' attribute with 'ONMOUSEOUT' */
-            if ( attrIsOnMOUSEOUT(av) )
-                HasOnMouseOut++;
-
-            if ( attrIsOnMOUSEOVER(av) )
-                HasOnMouseOver++;
-
-            if ( attrIsOnMOUSEMOVE(av) )
-                HasOnMouseMove++;
-
-            if ( attrIsOnKEYDOWN(av) )
-                HasOnMouseDown++;
-
-            if ( attrIsOnKEYUP(av) )
-                HasOnMouseUp++;
-
-            if ( attrIsOnKEYPRESS(av) )
-                HasOnClick++;
-
-            if ( attrIsOnBLUR(av) )
-                HasOnMouseOut++;
-        }
-
-        if ( HasOnMouseDown == 1 )
-            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_DOWN);
-
-        if ( HasOnMouseUp == 1 )
-            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_UP);
-
-        if ( HasOnClick == 1 )
-            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_CLICK);
-        if ( HasOnMouseOut == 1 )
-            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_OUT);
-
-        if ( HasOnMouseOver == 1 )
-            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_OVER);
-
-        if ( HasOnMouseMove == 1 )
-            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_MOVE);
-
-        /* Recursively check all child nodes.
-         */
-        for ( content = node->content; content != NULL; content = content->next )
-            CheckScriptKeyboardAccessible( doc, content );
-    }
-}
-
-
 /**********************************************************
 * CheckMetaData
 *
@@ -2828,28 +2707,115 @@ static void CheckDocType( TidyDocImpl* doc )
 * of an A element for every HREF of an AREA element. 
 ********************************************************/
 
+/* Returns the length of the scheme in "scheme://user@host:port/path"
+   and sets [*hostStart, *hostEnd) to the host and port, the parts in
+   which case does not matter.  All 0 for relative urls.
+*/
+static uint urlHost( ctmbstr url, uint* hostStart, uint* hostEnd )
+{
+    uint i = 0, scheme;
+
+    *hostStart = *hostEnd = 0;
+    if ( !TY_(IsLetter)(url[0]) )
+        return 0;
+    while ( TY_(IsLetter)(url[i]) || TY_(IsDigit)(url[i]) ||
+            url[i] == '+' || url[i] == '-' || url[i] == '.' )
+        ++i;
+    if ( url[i] != ':' )
+        return 0;
+    scheme = i++;
+
+    if ( url[i] == '/' && url[i+1] == '/' )
+    {
+        i += 2;
+        *hostStart = i;
+        while ( url[i] && url[i] != '/' && url[i] != '?' && url[i] != '#' )
+        {
+            if ( url[i] == '@' )
+                *hostStart = i + 1;
+            ++i;
+        }
+        *hostEnd = i;
+    }
+    return scheme;
+}
+
+/* Character i of url, folded to lower case within the scheme and host */
+static uint urlChar( ctmbstr url, uint i, uint scheme,
+                     uint hostStart, uint hostEnd )
+{
+    uint c = (byte) url[i];
+    if ( i < scheme || (i >= hostStart && i < hostEnd) )
+        c = TY_(ToLower)( c );
+    return c;
+}
+
+static uint urlHash( ctmbstr url )
+{
+    uint hostStart, hostEnd, i, hashval = 0;
+    uint scheme = urlHost( url, &hostStart, &hostEnd );
+
+    for ( i = 0; url[i]; ++i )
+        hashval = urlChar( url, i, scheme, hostStart, hostEnd ) + 31*hashval;
+    return hashval % LINK_HASH_SIZE;
+}
+
 static Bool urlMatch( ctmbstr url1, ctmbstr url2 )
 {
-  /* TODO: Make host part case-insensitive and
-  ** remainder case-sensitive.
-  */
-  return ( TY_(tmbstrcmp)( url1, url2 ) == 0 );
+    uint start1, end1, start2, end2, i;
+    uint scheme1 = urlHost( url1, &start1, &end1 );
+    uint scheme2 = urlHost( url2, &start2, &end2 );
+
+    for ( i = 0; url1[i] || url2[i]; ++i )
+    {
+        if ( urlChar(url1, i, scheme1, start1, end1) !=
+             urlChar(url2, i, scheme2, start2, end2) )
+            return no;
+    }
+    return yes;
 }
 
-static Bool FindLinkA( TidyDocImpl* doc, Node* node, ctmbstr url )
+/* Collects the 'HREF' values of all A elements in one pass */
+static void CollectLinks( TidyDocImpl* doc )
 {
-  Bool found = no;
-  for ( node = node->content; !found && node; node = node->next )
+  uint ix, count;
+  Node** links = TY_(GetNodesByTagId)( doc, TidyTag_A, &count );
+
+  doc->access.HasLinks = yes;
+  for ( ix = 0; ix < count; ++ix )
   {
-    if ( nodeIsA(node) )
-    {
-      AttVal* href = attrGetHREF( node );
-      found = ( hasValue(href) && urlMatch(url, href->value) );
+    AttVal* href = attrGetHREF( links[ix] );
+    if ( hasValue(href) )
+    {
+      uint h = urlHash( href->value );
+      AccessLink* link;
+
+      for ( link = doc->access.links[h]; link; link = link->next )
+        if ( urlMatch(link->href, href->value) )
+          break;
+      if ( link == NULL )
+      {
+        link = (AccessLink*) TidyDocAlloc( doc, sizeof(AccessLink) );
+        link->href = TY_(tmbstrdup)( doc->allocator, href->value );
+        link->next = doc->access.links[h];
+        doc->access.links[h] = link;
+      }
     }
-    else
-        found = FindLinkA( doc, node, url );
   }
-  return found;
+}
+
+static Bool FindLinkA( TidyDocImpl* doc, ctmbstr url )
+{
+  AccessLink* link;
+
+  if ( !doc->access.HasLinks )
+    CollectLinks( doc );
+  for ( link = doc->access.links[urlHash(url)]; link; link = link->next )
+  {
+    if ( urlMatch(url, link->href) )
+        return yes;
+  }
+  return no;
 }
 
 static void CheckMapLinks( TidyDocImpl* doc, Node* node )
@@ -2867,7 +2833,7 @@ static void CheckMapLinks( TidyDocImpl* doc, Node* node )
             /* Checks for 'HREF' attribute */                
             AttVal* href = attrGetHREF( child );
             if ( hasValue(href) &&
-                 !FindLinkA( doc, &doc->root, href->value ) )
+                 !FindLinkA( doc, href->value ) )
             {
                 TY_(ReportAccessError)( doc, node, IMG_MAP_CLIENT_MISSING_TEXT_LINKS );
             }
@@ -2876,53 +2842,108 @@ static void CheckMapLinks( TidyDocImpl* doc, Node* node )
 }
 
 
-/****************************************************
-* CheckForStyleAttribute
+/************************************************************
+* CheckAttributes
 *
-* Checks all elements within the document to check 
-* for the use of 'STYLE' attribute.
-****************************************************/
+* The checks of every node, in one pass over its attributes:
+*
+* Elements must have a device independent event handler if 
+* they have any of the following device dependent event 
+* handlers. 
+*
+* Elements must not use the 'STYLE' attribute.
+*
+* Notes whether style sheets or presentation attributes are
+* used, for STYLE_SHEET_CONTROL_PRESENTATION.
+************************************************************/
 
-static void CheckForStyleAttribute( TidyDocImpl* doc, Node* node )
+static void CheckAttributes( TidyDocImpl* doc, Node* node )
 {
-    Node* content;
-    if (Level1_Enabled( doc ))
+    int HasOnMouseDown = 0;
+    int HasOnMouseUp = 0;
+    int HasOnClick = 0;
+    int HasOnMouseOut = 0;
+    int HasOnMouseOver = 0;
+    int HasOnMouseMove = 0;
+    AttVal* style = NULL;
+    AttVal* av;
+
+    if ( nodeIsLINK(node)  ||
+         nodeIsSTYLE(node) ||
+         nodeIsFONT(node)  ||
+         nodeIsBASEFONT(node) )
+        doc->access.HasStyleSheets = yes;
+
+    for (av = node->attributes; av != NULL; av = av->next)
     {
-        /* Must not contain 'STYLE' attribute */
-        AttVal* style = attrGetSTYLE( node );
-        if ( hasValue(style) )
-        {
-            TY_(ReportAccessWarning)( doc, node, STYLESHEETS_REQUIRE_TESTING_STYLE_ATTR );
-        }
-    }
+        /* Must also have 'ONKEYDOWN' attribute with 'ONMOUSEDOWN' */
+        if ( attrIsOnMOUSEDOWN(av) )
+            HasOnMouseDown++;
 
-    /* Recursively check all child nodes.
-    */
-    for ( content = node->content; content != NULL; content = content->next )
-        CheckForStyleAttribute( doc, content );
-}
+        /* Must also have 'ONKEYUP' attribute with 'ONMOUSEUP' */
+        if ( attrIsOnMOUSEUP(av) )
+            HasOnMouseUp++;
 
+        /* Must also have 'ONKEYPRESS' attribute with 'ONCLICK' */
+        if ( attrIsOnCLICK(av) )
+            HasOnClick++;
 
-/*****************************************************
-* CheckForListElements
-*
-* Checks document for list elements (<ol>, <ul>, <li>)
-*****************************************************/
+        /* Must also have 'ONBLUR' attribute with 'ONMOUSEOUT' */
+        if ( attrIsOnMOUSEOUT(av) )
+            HasOnMouseOut++;
 
-static void CheckForListElements( TidyDocImpl* doc, Node* node )
-{
-    if ( nodeIsLI(node) )
-    {
-        doc->access.ListElements++;
+        if ( attrIsOnMOUSEOVER(av) )
+            HasOnMouseOver++;
+
+        if ( attrIsOnMOUSEMOVE(av) )
+            HasOnMouseMove++;
+
+        if ( attrIsOnKEYDOWN(av) )
+            HasOnMouseDown++;
+
+        if ( attrIsOnKEYUP(av) )
+            HasOnMouseUp++;
+
+        if ( attrIsOnKEYPRESS(av) )
+            HasOnClick++;
+
+        if ( attrIsOnBLUR(av) )
+            HasOnMouseOut++;
+
+        if ( attrIsSTYLE(av) && style == NULL )
+            style = av;
+
+        if ( attrIsSTYLE(av) || attrIsTEXT(av)  ||
+             attrIsVLINK(av) || attrIsALINK(av) ||
+             attrIsLINK(av) ||
+             ( attrIsREL(av) && AttrValueIs(av, "stylesheet") ) )
+            doc->access.HasStyleSheets = yes;
     }
-    else if ( nodeIsOL(node) || nodeIsUL(node) )
+
+    if (Level2_Enabled( doc ))
     {
-        doc->access.OtherListElements++;
+        if ( HasOnMouseDown == 1 )
+            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_DOWN);
+
+        if ( HasOnMouseUp == 1 )
+            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_UP);
+
+        if ( HasOnClick == 1 )
+            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_CLICK);
+        if ( HasOnMouseOut == 1 )
+            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_OUT);
+
+        if ( HasOnMouseOver == 1 )
+            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_OVER);
+
+        if ( HasOnMouseMove == 1 )
+            TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_MOVE);
     }
 
-    for ( node = node->content; node != NULL; node = node->next )
+    /* Must not contain 'STYLE' attribute */
+    if ( Level1_Enabled( doc ) && hasValue(style) )
     {
-        CheckForListElements( doc, node );
+        TY_(ReportAccessWarning)( doc, node, STYLESHEETS_REQUIRE_TESTING_STYLE_ATTR );
     }
 }
 
@@ -2985,6 +3006,139 @@ static void CheckListUsage( TidyDocImpl* doc, Node* node )
     }
 }
 
+/************************************************************
+* CheckHead
+*
+* Checks document for MetaData
+************************************************************/
+
+static void CheckHead( TidyDocImpl* doc, Node* node )
+{
+    if ( !CheckMetaData( doc, node, no ) )
+        MetaDataPresent( doc, node );
+}
+
+
+/* The checks of accessChecks[] that look at every node */
+#define AnyNode N_TIDY_TAGS
+
+typedef struct _AccessCheckDef
+{
+    TidyTagId    id;      /* element checked, or AnyNode */
+    int          level;   /* lowest priority level it reports at */
+    AccessCheck* check;
+} AccessCheckDef;
+
+/* All checks of single nodes, in the order they run on a node */
+static const AccessCheckDef accessChecks[] =
+{
+    { AnyNode,            1, CheckAttributes },
+    { TidyTag_BODY,       3, CheckColorContrast },
+    { TidyTag_HEAD,       2, CheckHead },
+    { TidyTag_A,          1, CheckAnchorAccess },
+    { TidyTag_IMG,        1, CheckFlicker },
+    { TidyTag_IMG,        1, CheckColorAvailable },
+    { TidyTag_IMG,        1, CheckImage },
+    { TidyTag_MAP,        3, CheckMapLinks },
+    { TidyTag_AREA,       1, CheckArea },
+    { TidyTag_APPLET,     1, CheckDeprecated },
+    { TidyTag_APPLET,     1, ProgrammaticObjects },
+    { TidyTag_APPLET,     1, DynamicContent },
+    { TidyTag_APPLET,     1, AccessibleCompatible },
+    { TidyTag_APPLET,     1, CheckFlicker },
+    { TidyTag_APPLET,     1, CheckColorAvailable },
+    { TidyTag_APPLET,     1, CheckApplet },
+    { TidyTag_OBJECT,     1, ProgrammaticObjects },
+    { TidyTag_OBJECT,     1, DynamicContent },
+    { TidyTag_OBJECT,     1, AccessibleCompatible },
+    { TidyTag_OBJECT,     1, CheckFlicker },
+    { TidyTag_OBJECT,     1, CheckColorAvailable },
+    { TidyTag_OBJECT,     1, CheckObject },
+    { TidyTag_FRAME,      1, CheckFrame },
+    { TidyTag_IFRAME,     1, CheckIFrame },
+    { TidyTag_SCRIPT,     1, DynamicContent },
+    { TidyTag_SCRIPT,     1, ProgrammaticObjects },
+    { TidyTag_SCRIPT,     1, AccessibleCompatible },
+    { TidyTag_SCRIPT,     1, CheckFlicker },
+    { TidyTag_SCRIPT,     1, CheckColorAvailable },
+    { TidyTag_SCRIPT,     1, CheckScriptAcc },
+    { TidyTag_TABLE,      3, CheckColorContrast },
+    { TidyTag_TABLE,      1, CheckTable },
+    { TidyTag_PRE,        1, CheckASCII },
+    { TidyTag_XMP,        1, CheckASCII },
+    { TidyTag_LABEL,      2, CheckLabel },
+    { TidyTag_INPUT,      1, CheckColorAvailable },
+    { TidyTag_INPUT,      2, CheckInputLabel },
+    { TidyTag_INPUT,      1, CheckInputAttributes },
+    { TidyTag_FRAMESET,   1, CheckFrameSet },
+    { TidyTag_H1,         2, CheckHeaderNesting },
+    { TidyTag_H2,         2, CheckHeaderNesting },
+    { TidyTag_H3,         2, CheckHeaderNesting },
+    { TidyTag_H4,         2, CheckHeaderNesting },
+    { TidyTag_H5,         2, CheckHeaderNesting },
+    { TidyTag_H6,         2, CheckHeaderNesting },
+    { TidyTag_P,          2, CheckParagraphHeader },
+    { TidyTag_HTML,       1, CheckHTMLAccess },
+    { TidyTag_BLINK,      1, CheckBlink },
+    { TidyTag_MARQUEE,    1, CheckMarquee },
+    { TidyTag_LINK,       1, CheckLink },
+    { TidyTag_STYLE,      3, CheckColorContrast },
+    { TidyTag_STYLE,      1, CheckStyle },
+    { TidyTag_EMBED,      1, CheckEmbed },
+    { TidyTag_EMBED,      1, ProgrammaticObjects },
+    { TidyTag_EMBED,      1, AccessibleCompatible },
+    { TidyTag_EMBED,      1, CheckFlicker },
+    { TidyTag_BASEFONT,   1, CheckDeprecated },
+    { TidyTag_CENTER,     1, CheckDeprecated },
+    { TidyTag_ISINDEX,    1, CheckDeprecated },
+    { TidyTag_U,          1, CheckDeprecated },
+    { TidyTag_FONT,       1, CheckDeprecated },
+    { TidyTag_DIR,        1, CheckDeprecated },
+    { TidyTag_S,          1, CheckDeprecated },
+    { TidyTag_STRIKE,     1, CheckDeprecated },
+    { TidyTag_MENU,       1, CheckDeprecated },
+    { TidyTag_TH,         3, CheckTH },
+    { TidyTag_LI,         2, CheckListUsage },
+    { TidyTag_OL,         2, CheckListUsage },
+    { TidyTag_UL,         2, CheckListUsage }
+};
+
+#define N_ACCESS_CHECKS (sizeof(accessChecks)/sizeof(accessChecks[0]))
+
+
+/************************************************************
+* RegisterAccessChecks
+*
+* Groups the checks of the enabled levels by tag id, so the
+* traversal finds the checks of a node in one lookup.
+************************************************************/
+
+static void RegisterAccessChecks( TidyDocImpl* doc )
+{
+    uint* start = doc->access.checkStart;
+    uint pos[ AnyNode + 1 ];
+    uint i, id;
+
+    for ( i = 0; i < N_ACCESS_CHECKS; ++i )
+    {
+        if ( accessChecks[i].level <= doc->access.PRIORITYCHK )
+            ++start[ accessChecks[i].id + 1 ];
+    }
+    for ( id = 0; id <= AnyNode; ++id )
+    {
+        start[ id + 1 ] += start[ id ];
+        pos[ id ] = start[ id ];
+    }
+
+    doc->access.checks = (AccessCheck**)
+        TidyDocAlloc( doc, start[AnyNode + 1] * sizeof(AccessCheck*) );
+    for ( i = 0; i < N_ACCESS_CHECKS; ++i )
+    {
+        if ( accessChecks[i].level <= doc->access.PRIORITYCHK )
+            doc->access.checks[ pos[accessChecks[i].id]++ ] = accessChecks[i].check;
+    }
+}
+
 /************************************************************
 * InitAccessibilityChecks
 *
@@ -2995,6 +3149,7 @@ static void InitAccessibilityChecks( TidyDocImpl* doc, int level123 )
 {
     TidyClearMemory( &doc->access, sizeof(doc->access) );
     doc->access.PRIORITYCHK = level123;
+    RegisterAccessChecks( doc );
 }
 
 /************************************************************
@@ -3004,24 +3159,24 @@ static void InitAccessibilityChecks( TidyDocImpl* doc, int level123 )
 ************************************************************/
 
 
-static void FreeAccessibilityChecks( TidyDocImpl* ARG_UNUSED(doc) )
+static void FreeAccessibilityChecks( TidyDocImpl* doc )
 {
-    /* free any memory allocated for the lists
-
-    Linked List of Links not used.  Just search document as 
-    AREA tags are encountered.  Same algorithm, but no
-    data structures necessary.
+    uint h;
 
-    current = start;
-    while (current)
+    for ( h = 0; h < LINK_HASH_SIZE; ++h )
     {
-        void    *templink = (void *)current;
-        
-        current = current->next;
-        TidyDocFree(doc, templink);
+        AccessLink* link;
+        while ( NULL != (link = doc->access.links[h]) )
+        {
+            doc->access.links[h] = link->next;
+            TidyDocFree( doc, link->href );
+            TidyDocFree( doc, link );
+        }
     }
-    start = NULL;
-    */
+    doc->access.HasLinks = no;
+
+    TidyDocFree( doc, doc->access.checks );
+    doc->access.checks = NULL;
 }
 
 /************************************************************
@@ -3029,207 +3184,27 @@ static void FreeAccessibilityChecks( TidyDocImpl* ARG_UNUSED(doc) )
 *
 * Traverses through the individual nodes of the tree
 * and checks attributes and elements for accessibility.
-* after the tree structure has been formed.
+* after the tree structure has been formed.  Each node is
+* visited once, running the checks registered for it.
 ************************************************************/
 
 static void AccessibilityCheckNode( TidyDocImpl* doc, Node* node )
 {
     Node* content;
-    
-    /* Check BODY for color contrast */
-    if ( nodeIsBODY(node) )
-    {
-        CheckColorContrast( doc, node );
-    }
-
-    /* Checks document for MetaData */
-    else if ( nodeIsHEAD(node) )
-    {
-        if ( !CheckMetaData( doc, node, no ) )
-          MetaDataPresent( doc, node );
-    }
-    
-    /* Check the ANCHOR tag */
-    else if ( nodeIsA(node) )
-    {
-        CheckAnchorAccess( doc, node );
-    }
-
-    /* Check the IMAGE tag */
-    else if ( nodeIsIMG(node) )
-    {
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckImage( doc, node );
-    }
-
-        /* Checks MAP for client-side text links */
-    else if ( nodeIsMAP(node) )
-    {
-        CheckMapLinks( doc, node );
-    }
-
-    /* Check the AREA tag */
-    else if ( nodeIsAREA(node) )
-    {
-        CheckArea( doc, node );
-    }
-
-    /* Check the APPLET tag */
-    else if ( nodeIsAPPLET(node) )
-    {
-        CheckDeprecated( doc, node );
-        ProgrammaticObjects( doc, node );
-        DynamicContent( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckApplet(doc, node );
-    }
-    
-    /* Check the OBJECT tag */
-    else if ( nodeIsOBJECT(node) )
-    {
-        ProgrammaticObjects( doc, node );
-        DynamicContent( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckObject( doc, node );
-    }
-    
-    /* Check the FRAME tag */
-    else if ( nodeIsFRAME(node) )
-    {
-        CheckFrame( doc, node );
-    }
-    
-    /* Check the IFRAME tag */
-    else if ( nodeIsIFRAME(node) )
-    {
-        CheckIFrame( doc, node );
-    }
-    
-    /* Check the SCRIPT tag */
-    else if ( nodeIsSCRIPT(node) )
-    {
-        DynamicContent( doc, node );
-        ProgrammaticObjects( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckScriptAcc( doc, node );
-    }
-
-    /* Check the TABLE tag */
-    else if ( nodeIsTABLE(node) )
-    {
-        CheckColorContrast( doc, node );
-        CheckTable( doc, node );
-    }
-
-    /* Check the PRE for ASCII art */
-    else if ( nodeIsPRE(node) || nodeIsXMP(node) )
-    {
-        CheckASCII( doc, node );
-    }
-
-    /* Check the LABEL tag */
-    else if ( nodeIsLABEL(node) )
-    {
-        CheckLabel( doc, node );
-    }
-
-    /* Check INPUT tag for validity */
-    else if ( nodeIsINPUT(node) )
-    {
-        CheckColorAvailable( doc, node );
-        CheckInputLabel( doc, node );
-        CheckInputAttributes( doc, node );
-    }
-
-    /* Checks FRAMESET element for NOFRAME section */
-    else if ( nodeIsFRAMESET(node) )
-    {
-        CheckFrameSet( doc, node );
-    }
-    
-    /* Checks for header elements for valid header increase */
-    else if ( TY_(nodeIsHeader)(node) )
-    {
-        CheckHeaderNesting( doc, node );
-    }
-
-    /* Checks P element to ensure that it is not a header */
-    else if ( nodeIsP(node) )
-    {
-        CheckParagraphHeader( doc, node );
-    }
-
-    /* Checks HTML elemnt for valid 'LANG' */
-    else if ( nodeIsHTML(node) )
-    {
-        CheckHTMLAccess( doc, node );
-    }
-
-    /* Checks BLINK for any blinking text */
-    else if ( nodeIsBLINK(node) )
-    {
-        CheckBlink( doc, node );
-    }
-
-    /* Checks MARQUEE for any MARQUEE text */
-    else if ( nodeIsMARQUEE(node) )
-    {
-        CheckMarquee( doc, node );
-    }
-
-    /* Checks LINK for 'REL' attribute */
-    else if ( nodeIsLINK(node) )
-    {
-        CheckLink( doc, node );
-    }
-
-    /* Checks to see if STYLE is used */
-    else if ( nodeIsSTYLE(node) )
-    {
-        CheckColorContrast( doc, node );
-        CheckStyle( doc, node );
-    }
-
-    /* Checks to see if EMBED is used */
-    else if ( nodeIsEMBED(node) )
-    {
-        CheckEmbed( doc, node );
-        ProgrammaticObjects( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-    }
+    uint* start = doc->access.checkStart;
+    uint i;
 
-    /* Deprecated HTML if the following tags are found in the document */
-    else if ( nodeIsBASEFONT(node) ||
-              nodeIsCENTER(node)   ||
-              nodeIsISINDEX(node)  ||
-              nodeIsU(node)        ||
-              nodeIsFONT(node)     ||
-              nodeIsDIR(node)      ||
-              nodeIsS(node)        ||
-              nodeIsSTRIKE(node)   ||
-              nodeIsMENU(node) )
-    {
-        CheckDeprecated( doc, node );
-    }
+    if ( TidyCancelled(doc) )
+        return;
 
-    /* Checks for 'ABBR' attribute if needed */
-    else if ( nodeIsTH(node) )
-    {
-        CheckTH( doc, node );
-    }
+    for ( i = start[AnyNode]; i < start[AnyNode + 1]; ++i )
+        doc->access.checks[i]( doc, node );
 
-    /* Ensures that lists are properly used */
-    else if ( nodeIsLI(node) || nodeIsOL(node) || nodeIsUL(node) )
+    if ( node->tag )
     {
-        CheckListUsage( doc, node );
+        TidyTagId id = node->tag->id;
+        for ( i = start[id]; i < start[id + 1]; ++i )
+            doc->access.checks[i]( doc, node );
     }
 
     /* Recursively check all child nodes.
@@ -3249,26 +3224,9 @@ void TY_(AccessibilityChecks)( TidyDocImpl* doc )
     /* Hello there, ladies and gentlemen... */
     TY_(AccessibilityHelloMessage)( doc );
 
-    /* Checks all elements for script accessibility */
-    CheckScriptKeyboardAccessible( doc, &doc->root );
-
-    /* Checks entire document for the use of 'STYLE' attribute */
-    CheckForStyleAttribute( doc, &doc->root );
-
     /* Checks for '!DOCTYPE' */
     CheckDocType( doc );
 
-    
-    /* Checks to see if stylesheets are used to control the layout */
-    if ( Level2_Enabled( doc )
-         && ! CheckMissingStyleSheets( doc, &doc->root ) )
-    {
-        TY_(ReportAccessWarning)( doc, &doc->root, STYLE_SHEET_CONTROL_PRESENTATION );
-    }
-
-    /* Check to see if any list elements are found within the document */
-    CheckForListElements( doc, &doc->root );
-
     /* Checks for natural language change */
     /* Must contain more than 3 words of text in the document
     **
@@ -3284,11 +3242,17 @@ void TY_(AccessibilityChecks)( TidyDocImpl* doc )
     */
 
 
-    /* Recursively apply all remaining checks to 
-    ** each node in document.
+    /* Apply all checks to each node in document.
     */
     AccessibilityCheckNode( doc, &doc->root );
 
+    /* Checks to see if stylesheets are used to control the layout */
+    if ( Level2_Enabled( doc ) && !doc->access.HasStyleSheets &&
+         !doc->cancelled )
+    {
+        TY_(ReportAccessWarning)( doc, &doc->root, STYLE_SHEET_CONTROL_PRESENTATION );
+    }
+
     /* Cleanup */
     FreeAccessibilityChecks( doc );
 }
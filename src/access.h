@@ -42,19 +42,22 @@
    3. priority 1, 2, & 3
 */
 
-/* Determines if the client-side text link is found within the document
-typedef struct AreaLinks
+/* The 'HREF' values of the A elements, looked up for each AREA of a MAP */
+typedef struct _AccessLink AccessLink;
+struct _AccessLink
 {
-    struct AreaLinks* next;
-    char* link;
-    Bool HasBeenFound;
-} AreaLinks;
-*/
+    AccessLink* next;
+    tmbstr      href;
+};
 
 enum {
-  TEXTBUF_SIZE=128u
+  TEXTBUF_SIZE=128u,
+  LINK_HASH_SIZE=1021u
 };
 
+/* A check of one node, visited once by the traversal of the document */
+typedef void (AccessCheck)( TidyDocImpl* doc, Node* node );
+
 struct _TidyAccessImpl;
 typedef struct _TidyAccessImpl TidyAccessImpl;
 
@@ -72,6 +75,16 @@ struct _TidyAccessImpl
     /* The list of characters found within one text node */
     tmbchar text[ TEXTBUF_SIZE ]; 
 
+    /* The text node copied to 'text' */
+    Node* textFrom;
+
+    /* The checks of the enabled levels, grouped by tag id.  The
+       checks of tag id i are checks[checkStart[i]] up to
+       checks[checkStart[i+1]], those of every node come last.
+    */
+    AccessCheck** checks;
+    uint checkStart[ N_TIDY_TAGS + 2 ];
+
     /* Number of frame elements found within a frameset */
     int numFrames; 
 
@@ -79,8 +92,9 @@ struct _TidyAccessImpl
     int HasCheckedLongDesc; 
 
     int  CheckedHeaders;
-    int  ListElements;
-    int  OtherListElements;
+
+    /* Any LINK, STYLE, FONT or BASEFONT, or presentation attributes */
+    Bool HasStyleSheets;
 
     /* For 'USEMAP' identifier */
     Bool HasUseMap; 
@@ -99,11 +113,9 @@ struct _TidyAccessImpl
     Bool HasInvalidColumnHeader;
     int  ForID;
 
-    /* List containing map-links
-    AreaLinks* links;
-    AreaLinks* start;
-    AreaLinks* current;
-    */
+    /* 'HREF' values of all A elements, collected by the first MAP */
+    Bool        HasLinks;
+    AccessLink* links[LINK_HASH_SIZE];
 
 };
 
@@ -108,6 +108,49 @@ TidyAllocator TY_(g_default_allocator) = {
     &defaultVtbl
 };
 
+static void* TIDY_CALL countingAlloc( TidyAllocator* allocator, size_t size )
+{
+    CountingAllocator* counter = (CountingAllocator*) allocator;
+    counter->count++;
+    counter->bytes += size;
+    return TidyAlloc( counter->inner, size );
+}
+
+static void* TIDY_CALL countingRealloc( TidyAllocator* allocator, void* mem, size_t newsize )
+{
+    CountingAllocator* counter = (CountingAllocator*) allocator;
+    counter->count++;
+    counter->bytes += newsize;
+    return TidyRealloc( counter->inner, mem, newsize );
+}
+
+static void TIDY_CALL countingFree( TidyAllocator* allocator, void* mem )
+{
+    CountingAllocator* counter = (CountingAllocator*) allocator;
+    TidyFree( counter->inner, mem );
+}
+
+static void TIDY_CALL countingPanic( TidyAllocator* allocator, ctmbstr msg )
+{
+    CountingAllocator* counter = (CountingAllocator*) allocator;
+    TidyPanic( counter->inner, msg );
+}
+
+static const TidyAllocatorVtbl countingVtbl = {
+    countingAlloc,
+    countingRealloc,
+    countingFree,
+    countingPanic
+};
+
+void TY_(InitCountingAllocator)( CountingAllocator* counter, TidyAllocator* inner )
+{
+    counter->base.vtbl = &countingVtbl;
+    counter->inner = inner;
+    counter->count = 0;
+    counter->bytes = 0;
+}
+
 /*
  * local variables:
  * mode: c
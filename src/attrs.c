@@ -1203,6 +1203,33 @@ void TY_(FreeAttrTable)( TidyDocImpl* doc )
     FreeDeclaredAttributes( doc );
 }
 
+/* A by-value copy of doc->attribs shares the hash chains of the
+** original; lookups through the copy only ever push new entries
+** in front of those shared chains (see attrsInstall), so free
+** entries until the chain joins the document's own one.
+*/
+void TY_(FreeAttrHashCopy)( TidyDocImpl* doc, TidyAttribImpl* copy )
+{
+#if ATTRIBUTE_HASH_LOOKUP
+    uint i;
+    for ( i = 0; i < ATTRIBUTE_HASH_SIZE; ++i )
+    {
+        AttrHash *p = copy->hashtab[i], *next, *q;
+        while ( p )
+        {
+            for ( q = doc->attribs.hashtab[i]; q && q != p; q = q->next )
+                /**/;
+            if ( q == p )
+                break;
+            next = p->next;
+            TidyDocFree( doc, p );
+            p = next;
+        }
+        copy->hashtab[i] = NULL;
+    }
+#endif
+}
+
 void TY_(AppendToClassAttr)( TidyDocImpl* doc, AttVal *classattr, ctmbstr classname )
 {
     uint len = TY_(tmbstrlen)(classattr->value) +
@@ -132,6 +132,9 @@ void TY_(FreeAnchors)( TidyDocImpl* doc );
 void TY_(InitAttrs)( TidyDocImpl* doc );
 void TY_(FreeAttrTable)( TidyDocImpl* doc );
 
+/* release the entries a private copy of doc->attribs added to its hash */
+void TY_(FreeAttrHashCopy)( TidyDocImpl* doc, TidyAttribImpl* copy );
+
 void TY_(AppendToClassAttr)( TidyDocImpl* doc, AttVal *classattr, ctmbstr classname );
 /*
  the same attribute name can't be used
@@ -57,7 +57,7 @@ static Node* CleanNode( TidyDocImpl* doc, Node *node );
 
 static void RenameElem( TidyDocImpl* doc, Node* node, TidyTagId tid )
 {
-    const Dict* dict = TY_(LookupTagDef)( tid );
+    const Dict* dict = TY_(LookupTagDef)( doc, tid );
     TidyDocFree( doc, node->element );
     node->element = TY_(tmbstrdup)( doc->allocator, dict->name );
     node->tag = dict;
@@ -77,129 +77,165 @@ static void FreeStyleProps(TidyDocImpl* doc, StyleProp *props)
     }
 }
 
-static StyleProp *InsertProperty( TidyDocImpl* doc, StyleProp* props, ctmbstr name, ctmbstr value )
+/*
+ A style declaration parsed out of a style attribute value.
+ Name and value point into the string that was parsed, so
+ merging two styles copies nothing until the result is
+ written out by DeclsToString().
+*/
+typedef struct _StyleDecl
 {
-    StyleProp *first, *prev, *prop;
-    int cmp;
+    ctmbstr name;
+    uint    nameLen;
+    ctmbstr value;
+    uint    valueLen;
+} StyleDecl;
 
-    prev = NULL;
-    first = props;
-
-    while (props)
-    {
-        cmp = TY_(tmbstrcmp)(props->name, name);
+/* Declarations sorted by property name, in local[] unless
+   a style has more properties than fit there */
+typedef struct _StyleDecls
+{
+    StyleDecl* decls;
+    uint       count;
+    uint       size;
+    StyleDecl  local[16];
+} StyleDecls;
 
-        if (cmp == 0)
-        {
-            /* this property is already defined, ignore new value */
-            return first;
-        }
+static void InitDecls( StyleDecls* block )
+{
+    block->decls = block->local;
+    block->count = 0;
+    block->size = sizeof(block->local)/sizeof(block->local[0]);
+}
 
-        if (cmp > 0)
-        {
-            /* insert before this */
+static void FreeDecls( TidyDocImpl* doc, StyleDecls* block )
+{
+    if ( block->decls != block->local )
+        TidyDocFree( doc, block->decls );
+    InitDecls( block );
+}
 
-            prop = (StyleProp *)TidyDocAlloc(doc, sizeof(StyleProp));
-            prop->name = TY_(tmbstrdup)(doc->allocator, name);
-            prop->value = TY_(tmbstrdup)(doc->allocator, value);
-            prop->next = props;
+/* same ordering as tmbstrcmp() on the NUL terminated names */
+static int CompareDeclNames( ctmbstr s1, uint len1, ctmbstr s2, uint len2 )
+{
+    uint i;
+    for ( i = 0; ; ++i )
+    {
+        tmbchar c1 = (tmbchar)( i < len1 ? s1[i] : '\0' );
+        tmbchar c2 = (tmbchar)( i < len2 ? s2[i] : '\0' );
 
-            if (prev)
-                prev->next = prop;
-            else
-                first = prop;
+        if ( c1 != c2 )
+            return (c1 > c2 ? 1 : -1);
+        if ( c1 == '\0' )
+            return 0;
+    }
+}
 
-            return first;
-        }
+static void InsertDecl( TidyDocImpl* doc, StyleDecls* block,
+                        ctmbstr name, uint nameLen,
+                        ctmbstr value, uint valueLen )
+{
+    uint i;
+    int cmp = 1;
 
-        prev = props;
-        props = props->next;
+    for ( i = 0; i < block->count; ++i )
+    {
+        StyleDecl* decl = &block->decls[i];
+        cmp = CompareDeclNames( decl->name, decl->nameLen, name, nameLen );
+        if ( cmp >= 0 )
+            break;
     }
 
-    prop = (StyleProp *)TidyDocAlloc(doc, sizeof(StyleProp));
-    prop->name = TY_(tmbstrdup)(doc->allocator, name);
-    prop->value = TY_(tmbstrdup)(doc->allocator, value);
-    prop->next = NULL;
+    /* this property is already defined, ignore new value */
+    if ( i < block->count && cmp == 0 )
+        return;
 
-    if (prev)
-        prev->next = prop;
-    else
-        first = prop;
+    if ( block->count == block->size )
+    {
+        uint size = block->size * 2;
+        StyleDecl* decls = (StyleDecl*) TidyDocAlloc( doc, size * sizeof(StyleDecl) );
+        memcpy( decls, block->decls, block->count * sizeof(StyleDecl) );
+        if ( block->decls != block->local )
+            TidyDocFree( doc, block->decls );
+        block->decls = decls;
+        block->size = size;
+    }
 
-    return first;
+    memmove( &block->decls[i+1], &block->decls[i],
+             (block->count - i) * sizeof(StyleDecl) );
+    block->decls[i].name = name;
+    block->decls[i].nameLen = nameLen;
+    block->decls[i].value = value;
+    block->decls[i].valueLen = valueLen;
+    ++block->count;
 }
 
 /*
- Create sorted linked list of properties from style string
- It temporarily places nulls in place of ':' and ';' to
- delimit the strings for the property name and value.
- Some systems don't allow you to NULL literal strings,
- so to avoid this, a copy is made first.
+ Add the declarations of a style string to the block.
+ Parsing stops at the first declaration without a ':'.
+ The style string must outlive the block.
 */
-static StyleProp* CreateProps( TidyDocImpl* doc, StyleProp* prop, ctmbstr style )
+static void ParseDecls( TidyDocImpl* doc, StyleDecls* block, ctmbstr style )
 {
-    tmbstr name, value = NULL, name_end, value_end, line;
-    Bool more;
-
-    line = TY_(tmbstrdup)(doc->allocator, style);
-    name = line;
+    ctmbstr name = style, name_end, value, value_end;
 
     while (*name)
     {
         while (*name == ' ')
             ++name;
 
-        name_end = name;
-
-        while (*name_end)
-        {
-            if (*name_end == ':')
-            {
-                value = name_end + 1;
-                break;
-            }
-
-            ++name_end;
-        }
+        for ( name_end = name; *name_end && *name_end != ':'; ++name_end )
+            continue;
 
         if (*name_end != ':')
             break;
 
-        while ( value && *value == ' ')
-            ++value;
+        for ( value = name_end + 1; *value == ' '; ++value )
+            continue;
+
+        for ( value_end = value; *value_end && *value_end != ';'; ++value_end )
+            continue;
 
-        value_end = value;
-        more = no;
+        InsertDecl( doc, block, name, (uint)(name_end - name),
+                    value, (uint)(value_end - value) );
 
-        while (*value_end)
-        {
-            if (*value_end == ';')
-            {
-                more = yes;
-                break;
-            }
+        if (*value_end != ';')
+            break;
 
-            ++value_end;
-        }
+        name = value_end + 1;
+    }
+}
 
-        *name_end = '\0';
-        *value_end = '\0';
+/* write the block out as "name: value; name: value" */
+static tmbstr DeclsToString( TidyDocImpl* doc, StyleDecls* block )
+{
+    tmbstr style, p;
+    uint i, len = 0;
+
+    for ( i = 0; i < block->count; ++i )
+        len += block->decls[i].nameLen + block->decls[i].valueLen + 4;
 
-        prop = InsertProperty(doc, prop, name, value);
-        *name_end = ':';
+    p = style = (tmbstr) TidyDocAlloc( doc, len + 1 );
 
-        if (more)
+    for ( i = 0; i < block->count; ++i )
+    {
+        StyleDecl* decl = &block->decls[i];
+
+        if ( i > 0 )
         {
-            *value_end = ';';
-            name = value_end + 1;
-            continue;
+            *p++ = ';';
+            *p++ = ' ';
         }
-
-        break;
+        memcpy( p, decl->name, decl->nameLen );
+        p += decl->nameLen;
+        *p++ = ':';
+        *p++ = ' ';
+        memcpy( p, decl->value, decl->valueLen );
+        p += decl->valueLen;
     }
+    *p = '\0';
 
-    TidyDocFree(doc, line);  /* free temporary copy */
-    return prop;
+    return style;
 }
 
 static tmbstr CreatePropString(TidyDocImpl* doc, StyleProp *props)
@@ -248,21 +284,6 @@ static tmbstr CreatePropString(TidyDocImpl* doc, StyleProp *props)
     return style;
 }
 
-/*
-  create string with merged properties
-static tmbstr AddProperty( ctmbstr style, ctmbstr property )
-{
-    tmbstr line;
-    StyleProp *prop;
-
-    prop = CreateProps(doc, NULL, style);
-    prop = CreateProps(doc, prop, property);
-    line = CreatePropString(doc, prop);
-    FreeStyleProps(doc, prop);
-    return line;
-}
-*/
-
 void TY_(FreeStyles)( TidyDocImpl* doc )
 {
     Lexer* lexer = doc->lexer;
@@ -277,6 +298,9 @@ void TY_(FreeStyles)( TidyDocImpl* doc )
             TidyDocFree( doc, style->properties );
             TidyDocFree( doc, style );
         }
+        lexer->styles = NULL;
+        TidyDocFree( doc, lexer->styleHash );
+        lexer->styleHash = NULL;
     }
 }
 
@@ -291,12 +315,35 @@ static tmbstr GensymClass( TidyDocImpl* doc )
     return TY_(tmbstrdup)(doc->allocator, buf);
 }
 
+static uint styleHash( ctmbstr tag, ctmbstr properties )
+{
+    uint hashval = 0;
+    for ( ; *tag != '\0'; tag++ )
+        hashval = *tag + 31*hashval;
+    for ( ; *properties != '\0'; properties++ )
+        hashval = *properties + 31*hashval;
+    return hashval % STYLE_HASH_SIZE;
+}
+
+/*
+ The styles list keeps the order the rules are written in,
+ the hash table finds a tag and property set without a walk
+ over all of them.
+*/
 static ctmbstr FindStyle( TidyDocImpl* doc, ctmbstr tag, ctmbstr properties )
 {
     Lexer* lexer = doc->lexer;
     TagStyle* style;
+    uint h = styleHash( tag, properties );
 
-    for (style = lexer->styles; style; style=style->next)
+    if ( lexer->styleHash == NULL )
+    {
+        uint size = STYLE_HASH_SIZE * sizeof(TagStyle*);
+        lexer->styleHash = (TagStyle**) TidyDocAlloc( doc, size );
+        TidyClearMemory( lexer->styleHash, size );
+    }
+
+    for (style = lexer->styleHash[h]; style; style=style->hashNext)
     {
         if (TY_(tmbstrcmp)(style->tag, tag) == 0 &&
             TY_(tmbstrcmp)(style->properties, properties) == 0)
@@ -309,6 +356,8 @@ static ctmbstr FindStyle( TidyDocImpl* doc, ctmbstr tag, ctmbstr properties )
     style->properties = TY_(tmbstrdup)( doc->allocator, properties );
     style->next = lexer->styles;
     lexer->styles = style;
+    style->hashNext = lexer->styleHash[h];
+    lexer->styleHash[h] = style;
     return style->tag_class;
 }
 
@@ -551,6 +600,8 @@ static void CreateStyleElement( TidyDocImpl* doc )
     */
     if ( NULL != (head = TY_(FindHEAD)( doc )) )
         TY_(InsertNodeAtEnd)( head, node );
+    else
+        TY_(FreeNode)( doc, node );  /* fragments have no head */
 }
 
 
@@ -636,20 +687,20 @@ static void DiscardContainer( TidyDocImpl* doc, Node *element, Node **pnode)
   Create new string that consists of the
   combined style properties in s1 and s2
 
-  To merge property lists, we build a linked
-  list of property/values and insert properties
-  into the list in order, merging values for
-  the same property name.
+  To merge property lists, we parse both into
+  one block of declarations sorted by name,
+  keeping the first value for each property.
 */
 static tmbstr MergeProperties( TidyDocImpl* doc, ctmbstr s1, ctmbstr s2 )
 {
     tmbstr s;
-    StyleProp *prop;
+    StyleDecls block;
 
-    prop = CreateProps(doc, NULL, s1);
-    prop = CreateProps(doc, prop, s2);
-    s = CreatePropString(doc, prop);
-    FreeStyleProps(doc, prop);
+    InitDecls( &block );
+    ParseDecls( doc, &block, s1 );
+    ParseDecls( doc, &block, s2 );
+    s = DeclsToString( doc, &block );
+    FreeDecls( doc, &block );
     return s;
 }
 
@@ -987,7 +1038,7 @@ static Bool Dir2Div( TidyDocImpl* doc, Node *node, Node **ARG_UNUSED(pnode))
             return no;
 
         /* coerce dir to div */
-        node->tag = TY_(LookupTagDef)( TidyTag_DIV );
+        node->tag = TY_(LookupTagDef)( doc, TidyTag_DIV );
         TidyDocFree( doc, node->element );
         node->element = TY_(tmbstrdup)(doc->allocator, "div");
         TY_(AddStyleProperty)( doc, node, "margin-left: 2em" );
@@ -1493,6 +1544,9 @@ Node* CleanNode( TidyDocImpl* doc, Node *node )
 
 static Node* CleanTree( TidyDocImpl* doc, Node *node )
 {
+    if ( TidyCancelled(doc) )
+        return node;
+
     if (node->content)
     {
         Node *child;
@@ -1565,20 +1619,22 @@ void TY_(NestedEmphasis)( TidyDocImpl* doc, Node* node )
 
 
 /* replace i by em and b by strong */
-void TY_(EmFromI)( TidyDocImpl* doc, Node* node )
+void TY_(EmFromINode)( TidyDocImpl* doc, Node* node, void* ARG_UNUSED(unused) )
 {
-    while (node)
-    {
-        if ( nodeIsI(node) )
-            RenameElem( doc, node, TidyTag_EM );
-        else if ( nodeIsB(node) )
-            RenameElem( doc, node, TidyTag_STRONG );
+    if ( nodeIsI(node) )
+        RenameElem( doc, node, TidyTag_EM );
+    else if ( nodeIsB(node) )
+        RenameElem( doc, node, TidyTag_STRONG );
+}
 
-        if ( node->content )
-            TY_(EmFromI)( doc, node->content );
+void TY_(EmFromI)( TidyDocImpl* doc, Node* node )
+{
+    TreePass pass;
 
-        node = node->next;
-    }
+    pass.pre = TY_(EmFromINode);
+    pass.post = NULL;
+    pass.propagate = NULL;
+    TY_(RunTreePasses)( doc, node, &pass, 1 );
 }
 
 static Bool HasOneChild(Node *node)
@@ -1593,23 +1649,25 @@ static Bool HasOneChild(Node *node)
  li. This is recursively replaced by an
  implicit blockquote.
 */
-void TY_(List2BQ)( TidyDocImpl* doc, Node* node )
+void TY_(List2BQNode)( TidyDocImpl* doc, Node* node, void* ARG_UNUSED(unused) )
 {
-    while (node)
+    if ( node->tag && node->tag->parser == TY_(ParseList) &&
+         HasOneChild(node) && node->content->implicit )
     {
-        if (node->content)
-            TY_(List2BQ)( doc, node->content );
+        StripOnlyChild( doc, node );
+        RenameElem( doc, node, TidyTag_BLOCKQUOTE );
+        node->implicit = yes;
+    }
+}
 
-        if ( node->tag && node->tag->parser == TY_(ParseList) &&
-             HasOneChild(node) && node->content->implicit )
-        {
-            StripOnlyChild( doc, node );
-            RenameElem( doc, node, TidyTag_BLOCKQUOTE );
-            node->implicit = yes;
-        }
+void TY_(List2BQ)( TidyDocImpl* doc, Node* node )
+{
+    TreePass pass;
 
-        node = node->next;
-    }
+    pass.pre = NULL;
+    pass.post = TY_(List2BQNode);
+    pass.propagate = NULL;
+    TY_(RunTreePasses)( doc, node, &pass, 1 );
 }
 
 
@@ -2042,7 +2100,7 @@ void TY_(CleanWord2000)( TidyDocImpl* doc, Node *node)
 
                 if ( !list || TagId(list) != listType )
                 {
-                    const Dict* tag = TY_(LookupTagDef)( listType );
+                    const Dict* tag = TY_(LookupTagDef)( doc, listType );
                     list = TY_(InferredTag)(doc, tag->id);
                     TY_(InsertNodeBeforeElement)(node, list);
                 }
@@ -2507,57 +2565,61 @@ void TY_(ConvertCDATANodes)(TidyDocImpl* doc, Node* node)
   'xml:lang' and 'lang' are desired, for XHTML 1.1 only 'xml:lang'
   is desired and for HTML 4.01 only 'lang' is desired.
 */
-void TY_(FixLanguageInformation)(TidyDocImpl* doc, Node* node, Bool wantXmlLang, Bool wantLang)
+void TY_(FixLanguageNode)(TidyDocImpl* doc, Node* node, void* wants)
 {
-    Node* next;
+    Bool wantXmlLang = ((Bool*)wants)[0];
+    Bool wantLang = ((Bool*)wants)[1];
 
-    while (node)
-    {
-        next = node->next;
+    /* todo: report modifications made here to the report system */
 
-        /* todo: report modifications made here to the report system */
+    if (TY_(nodeIsElement)(node))
+    {
+        AttVal* lang = TY_(AttrGetById)(node, TidyAttr_LANG);
+        AttVal* xmlLang = TY_(AttrGetById)(node, TidyAttr_XML_LANG);
 
-        if (TY_(nodeIsElement)(node))
+        if (lang && xmlLang)
         {
-            AttVal* lang = TY_(AttrGetById)(node, TidyAttr_LANG);
-            AttVal* xmlLang = TY_(AttrGetById)(node, TidyAttr_XML_LANG);
-
-            if (lang && xmlLang)
-            {
-                /*
-                  todo: check whether both attributes are in sync,
-                  here or elsewhere, where elsewhere is probably
-                  preferable.
-                  AD - March 2005: not mandatory according the standards.
-                */
-            }
-            else if (lang && wantXmlLang)
-            {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_XML_LANG )
-                    & doc->lexer->versionEmitted)
-                    TY_(RepairAttrValue)(doc, node, "xml:lang", lang->value);
-            }
-            else if (xmlLang && wantLang)
-            {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_LANG )
-                    & doc->lexer->versionEmitted)
-                    TY_(RepairAttrValue)(doc, node, "lang", xmlLang->value);
-            }
-
-            if (lang && !wantLang)
-                TY_(RemoveAttribute)(doc, node, lang);
-            
-            if (xmlLang && !wantXmlLang)
-                TY_(RemoveAttribute)(doc, node, xmlLang);
+            /*
+              todo: check whether both attributes are in sync,
+              here or elsewhere, where elsewhere is probably
+              preferable.
+              AD - March 2005: not mandatory according the standards.
+            */
+        }
+        else if (lang && wantXmlLang)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_XML_LANG )
+                & doc->lexer->versionEmitted)
+                TY_(RepairAttrValue)(doc, node, "xml:lang", lang->value);
+        }
+        else if (xmlLang && wantLang)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_LANG )
+                & doc->lexer->versionEmitted)
+                TY_(RepairAttrValue)(doc, node, "lang", xmlLang->value);
         }
 
-        if (node->content)
-            TY_(FixLanguageInformation)(doc, node->content, wantXmlLang, wantLang);
-
-        node = next;
+        if (lang && !wantLang)
+            TY_(RemoveAttribute)(doc, node, lang);
+        
+        if (xmlLang && !wantXmlLang)
+            TY_(RemoveAttribute)(doc, node, xmlLang);
     }
 }
 
+void TY_(FixLanguageInformation)(TidyDocImpl* doc, Node* node, Bool wantXmlLang, Bool wantLang)
+{
+    Bool wants[2];
+    TreePass pass;
+
+    wants[0] = wantXmlLang;
+    wants[1] = wantLang;
+    pass.pre = TY_(FixLanguageNode);
+    pass.post = NULL;
+    pass.propagate = wants;
+    TY_(RunTreePasses)( doc, node, &pass, 1 );
+}
+
 /*
   Set/fix/remove <html xmlns='...'>
 */
@@ -2585,81 +2647,85 @@ void TY_(FixXhtmlNamespace)(TidyDocImpl* doc, Bool wantXmlns)
 /*
   ...
 */
-void TY_(FixAnchors)(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId)
+void TY_(FixAnchorsNode)(TidyDocImpl* doc, Node *node, void* wants)
 {
-    Node* next;
+    Bool wantName = ((Bool*)wants)[0];
+    Bool wantId = ((Bool*)wants)[1];
 
-    while (node)
+    if (TY_(IsAnchorElement)(doc, node))
     {
-        next = node->next;
-
-        if (TY_(IsAnchorElement)(doc, node))
-        {
-            AttVal *name = TY_(AttrGetById)(node, TidyAttr_NAME);
-            AttVal *id = TY_(AttrGetById)(node, TidyAttr_ID);
-            Bool hadName = name!=NULL;
-            Bool hadId = id!=NULL;
-            Bool IdEmitted = no;
-            Bool NameEmitted = no;
+        AttVal *name = TY_(AttrGetById)(node, TidyAttr_NAME);
+        AttVal *id = TY_(AttrGetById)(node, TidyAttr_ID);
+        Bool hadName = name!=NULL;
+        Bool hadId = id!=NULL;
+        Bool IdEmitted = no;
+        Bool NameEmitted = no;
 
-            /* todo: how are empty name/id attributes handled? */
+        /* todo: how are empty name/id attributes handled? */
 
-            if (name && id)
-            {
-                Bool NameHasValue = AttrHasValue(name);
-                Bool IdHasValue = AttrHasValue(id);
-                if ( (NameHasValue != IdHasValue) ||
-                     (NameHasValue && IdHasValue &&
-                     TY_(tmbstrcmp)(name->value, id->value) != 0 ) )
-                    TY_(ReportAttrError)( doc, node, name, ID_NAME_MISMATCH);
-            }
-            else if (name && wantId)
-            {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_ID )
-                    & doc->lexer->versionEmitted)
-                {
-                    if (TY_(IsValidHTMLID)(name->value))
-                    {
-                        TY_(RepairAttrValue)(doc, node, "id", name->value);
-                        IdEmitted = yes;
-                    }
-                    else
-                        TY_(ReportAttrError)(doc, node, name, INVALID_XML_ID);
-                 }
-            }
-            else if (id && wantName)
+        if (name && id)
+        {
+            Bool NameHasValue = AttrHasValue(name);
+            Bool IdHasValue = AttrHasValue(id);
+            if ( (NameHasValue != IdHasValue) ||
+                 (NameHasValue && IdHasValue &&
+                 TY_(tmbstrcmp)(name->value, id->value) != 0 ) )
+                TY_(ReportAttrError)( doc, node, name, ID_NAME_MISMATCH);
+        }
+        else if (name && wantId)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_ID )
+                & doc->lexer->versionEmitted)
             {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_NAME )
-                    & doc->lexer->versionEmitted)
+                if (TY_(IsValidHTMLID)(name->value))
                 {
-                    /* todo: do not assume id is valid */
-                    TY_(RepairAttrValue)(doc, node, "name", id->value);
-                    NameEmitted = yes;
+                    TY_(RepairAttrValue)(doc, node, "id", name->value);
+                    IdEmitted = yes;
                 }
+                else
+                    TY_(ReportAttrError)(doc, node, name, INVALID_XML_ID);
+             }
+        }
+        else if (id && wantName)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_NAME )
+                & doc->lexer->versionEmitted)
+            {
+                /* todo: do not assume id is valid */
+                TY_(RepairAttrValue)(doc, node, "name", id->value);
+                NameEmitted = yes;
             }
+        }
 
-            if (id && !wantId
-                /* make sure that Name has been emitted if requested */
-                && (hadName || !wantName || NameEmitted) ) {
-                if (!wantId && !wantName)
-                    TY_(RemoveAnchorByNode)(doc, id->value, node);
-                TY_(RemoveAttribute)(doc, node, id);
-            }
+        if (id && !wantId
+            /* make sure that Name has been emitted if requested */
+            && (hadName || !wantName || NameEmitted) ) {
+            if (!wantId && !wantName)
+                TY_(RemoveAnchorByNode)(doc, id->value, node);
+            TY_(RemoveAttribute)(doc, node, id);
+        }
 
-            if (name && !wantName
-                /* make sure that Id has been emitted if requested */
-                && (hadId || !wantId || IdEmitted) ) {
-                if (!wantId && !wantName)
-                    TY_(RemoveAnchorByNode)(doc, name->value, node);
-                TY_(RemoveAttribute)(doc, node, name);
-            }
+        if (name && !wantName
+            /* make sure that Id has been emitted if requested */
+            && (hadId || !wantId || IdEmitted) ) {
+            if (!wantId && !wantName)
+                TY_(RemoveAnchorByNode)(doc, name->value, node);
+            TY_(RemoveAttribute)(doc, node, name);
         }
+    }
+}
 
-        if (node->content)
-            TY_(FixAnchors)(doc, node->content, wantName, wantId);
+void TY_(FixAnchors)(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId)
+{
+    Bool wants[2];
+    TreePass pass;
 
-        node = next;
-    }
+    wants[0] = wantName;
+    wants[1] = wantId;
+    pass.pre = TY_(FixAnchorsNode);
+    pass.post = NULL;
+    pass.propagate = wants;
+    TY_(RunTreePasses)( doc, node, &pass, 1 );
 }
 
 /*
@@ -24,6 +24,7 @@ void TY_(NestedEmphasis)( TidyDocImpl* doc, Node* node );
 
 /* replace i by em and b by strong */
 void TY_(EmFromI)( TidyDocImpl* doc, Node* node );
+void TY_(EmFromINode)( TidyDocImpl* doc, Node* node, void* unused );
 
 /*
  Some people use dir or ul without an li
@@ -33,6 +34,7 @@ void TY_(EmFromI)( TidyDocImpl* doc, Node* node );
  implicit blockquote.
 */
 void TY_(List2BQ)( TidyDocImpl* doc, Node* node );
+void TY_(List2BQNode)( TidyDocImpl* doc, Node* node, void* unused );
 
 /*
  Replace implicit blockquote by div with an indent
@@ -78,5 +80,10 @@ void TY_(FixAnchors)(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId);
 void TY_(FixXhtmlNamespace)(TidyDocImpl* doc, Bool wantXmlns);
 void TY_(FixLanguageInformation)(TidyDocImpl* doc, Node* node, Bool wantXmlLang, Bool wantLang);
 
+/* Per node steps of the above, as tree pass hooks; 'wants' points to the
+   two Bool arguments of the whole tree version */
+void TY_(FixAnchorsNode)(TidyDocImpl* doc, Node *node, void* wants);
+void TY_(FixLanguageNode)(TidyDocImpl* doc, Node* node, void* wants);
+
 
 #endif /* __CLEAN_H__ */
@@ -49,10 +49,12 @@ void TY_(InitConfig)( TidyDocImpl* doc )
     TY_(ResetConfigToDefault)( doc );
 }
 
+static void CopySnapshot( TidyDocImpl* doc );
+
 void TY_(FreeConfig)( TidyDocImpl* doc )
 {
     TY_(ResetConfigToDefault)( doc );
-    TY_(TakeConfigSnapshot)( doc );
+    CopySnapshot( doc );  /* frees the strings of the snapshot */
 }
 
 
@@ -208,7 +210,6 @@ static ParseProperty ParseRepeatAttr;
  * 20150515 - support using tabs instead of spaces - Issue #108
  * (a) parser for 't'/'f', 'true'/'false', 'y'/'n', 'yes'/'no' or '1'/'0' 
  * (b) sets the TidyIndentSpaces to 1 if 'yes'
- * (c) sets the indent_char to '\t' or ' '
 \*/
 static ParseProperty ParseTabs;
 
@@ -322,6 +323,13 @@ static const TidyOptionImpl option_defs[] =
   { TidyAnchorAsName,            MU, "anchor-as-name",              BL, yes,             ParseBool,         boolPicks       },
   { TidyPPrintTabs,              PP, "indent-with-tabs",            BL, no,              ParseTabs,         boolPicks       }, /* 20150515 - Issue #108 */
   { TidySkipNested,              MU, "skip-nested",                 BL, yes,             ParseBool,         boolPicks       }, /* 1642186 - Issue #65 */
+  { TidyPrintThreads,            PP, "print-threads",               IN, 0,               ParseInt,          NULL            },
+  { TidyMinify,                  PP, "minify",                      BL, no,              ParseBool,         boolPicks       },
+  { TidyShowRepeats,             DG, "show-repeats",                IN, 0,               ParseInt,          NULL            },
+  { TidyMaxInputSize,            MS, "max-input-size",              IN, 0,               ParseInt,          NULL            },
+  { TidyMaxNodes,                MS, "max-nodes",                   IN, 0,               ParseInt,          NULL            },
+  { TidyMaxDepth,                MS, "max-depth",                   IN, 0,               ParseInt,          NULL            },
+  { TidyMaxAttributes,           MS, "max-attributes",              IN, 0,               ParseInt,          NULL            },
   { N_TIDY_OPTIONS,              XX, NULL,                          XY, 0,               NULL,              NULL            }
 };
 
@@ -372,6 +380,17 @@ static void CopyOptionValue( TidyDocImpl* doc, const TidyOptionImpl* option,
 }
 
 
+/* Snapshots are taken lazily: TakeConfigSnapshot() only notes that
+** the snapshot equals the current values, and the values are copied
+** when one of them is about to change.  Everything that writes to
+** config.value must call this first.
+*/
+static void ResolveSnapshot( TidyDocImpl* doc )
+{
+    if ( doc->config.snapshotPending )
+        CopySnapshot( doc );
+}
+
 static Bool SetOptionValue( TidyDocImpl* doc, TidyOptionId optId, ctmbstr val )
 {
    const TidyOptionImpl* option = &option_defs[ optId ];
@@ -379,6 +398,7 @@ static Bool SetOptionValue( TidyDocImpl* doc, TidyOptionId optId, ctmbstr val )
    if ( status )
    {
       assert( option->id == optId && option->type == TidyString );
+      ResolveSnapshot( doc );
       FreeOptionValue( doc, option, &doc->config.value[ optId ] );
       if ( TY_(tmbstrlen)(val)) /* Issue #218 - ONLY if it has LENGTH! */
           doc->config.value[ optId ].p = TY_(tmbstrdup)( doc->allocator, val );
@@ -394,7 +414,11 @@ Bool TY_(SetOptionInt)( TidyDocImpl* doc, TidyOptionId optId, ulong val )
    if ( status )
    {
        assert( option_defs[ optId ].type == TidyInteger );
-       doc->config.value[ optId ].v = val;
+       if ( doc->config.value[ optId ].v != val )
+       {
+           ResolveSnapshot( doc );
+           doc->config.value[ optId ].v = val;
+       }
    }
    return status;
 }
@@ -405,7 +429,11 @@ Bool TY_(SetOptionBool)( TidyDocImpl* doc, TidyOptionId optId, Bool val )
    if ( status )
    {
        assert( option_defs[ optId ].type == TidyBoolean );
-       doc->config.value[ optId ].v = val;
+       if ( doc->config.value[ optId ].v != (ulong) val )
+       {
+           ResolveSnapshot( doc );
+           doc->config.value[ optId ].v = val;
+       }
    }
    return status;
 }
@@ -437,6 +465,7 @@ Bool TY_(ResetOptionToDefault)( TidyDocImpl* doc, TidyOptionId optId )
         TidyOptionValue* value = &doc->config.value[ optId ];
         assert( optId == option->id );
         GetOptionDefault( option, &dflt );
+        ResolveSnapshot( doc );
         CopyOptionValue( doc, option, value, &dflt );
     }
     return status;
@@ -518,6 +547,8 @@ void TY_(ResetConfigToDefault)( TidyDocImpl* doc )
     uint ixVal;
     const TidyOptionImpl* option = option_defs;
     TidyOptionValue* value = &doc->config.value[ 0 ];
+
+    ResolveSnapshot( doc );
     for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
     {
         TidyOptionValue dflt;
@@ -528,19 +559,25 @@ void TY_(ResetConfigToDefault)( TidyDocImpl* doc )
     TY_(FreeDeclaredTags)( doc, tagtype_null );
 }
 
-void TY_(TakeConfigSnapshot)( TidyDocImpl* doc )
+static void CopySnapshot( TidyDocImpl* doc )
 {
     uint ixVal;
     const TidyOptionImpl* option = option_defs;
     const TidyOptionValue* value = &doc->config.value[ 0 ];
     TidyOptionValue* snap  = &doc->config.snapshot[ 0 ];
 
-    AdjustConfig( doc );  /* Make sure it's consistent */
     for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
     {
         assert( ixVal == (uint) option->id );
         CopyOptionValue( doc, option, &snap[ixVal], &value[ixVal] );
     }
+    doc->config.snapshotPending = no;
+}
+
+void TY_(TakeConfigSnapshot)( TidyDocImpl* doc )
+{
+    AdjustConfig( doc );  /* Make sure it's consistent */
+    doc->config.snapshotPending = yes;
 }
 
 void TY_(ResetConfigToSnapshot)( TidyDocImpl* doc )
@@ -550,9 +587,12 @@ void TY_(ResetConfigToSnapshot)( TidyDocImpl* doc )
     TidyOptionValue* value = &doc->config.value[ 0 ];
     const TidyOptionValue* snap  = &doc->config.snapshot[ 0 ];
     uint changedUserTags;
-    Bool needReparseTagsDecls = NeedReparseTagDecls( value, snap,
-                                                     &changedUserTags );
-    
+    Bool needReparseTagsDecls;
+
+    if ( doc->config.snapshotPending )
+        return;  /* nothing changed since */
+
+    needReparseTagsDecls = NeedReparseTagDecls( value, snap, &changedUserTags );
     for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
     {
         assert( ixVal == (uint) option->id );
@@ -560,6 +600,9 @@ void TY_(ResetConfigToSnapshot)( TidyDocImpl* doc )
     }
     if ( needReparseTagsDecls )
         ReparseTagDecls( doc, changedUserTags );
+
+    /* values and snapshot agree again */
+    doc->config.snapshotPending = yes;
 }
 
 void TY_(CopyConfig)( TidyDocImpl* docTo, TidyDocImpl* docFrom )
@@ -575,6 +618,7 @@ void TY_(CopyConfig)( TidyDocImpl* docTo, TidyDocImpl* docFrom )
                                                          &changedUserTags );
 
         TY_(TakeConfigSnapshot)( docTo );
+        ResolveSnapshot( docTo );
         for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
         {
             assert( ixVal == (uint) option->id );
@@ -586,6 +630,77 @@ void TY_(CopyConfig)( TidyDocImpl* docTo, TidyDocImpl* docFrom )
     }
 }
 
+/* A profile is a frozen copy of a document's option values.  It is
+** never changed after creation, so any number of documents, also on
+** different threads, may apply it at the same time.
+*/
+struct _TidyConfigProfileImpl
+{
+    TidyAllocator*  allocator;
+    TidyOptionValue value[ N_TIDY_OPTIONS ];
+};
+
+TidyConfigProfileImpl* TY_(NewConfigProfile)( TidyDocImpl* doc )
+{
+    uint ixVal;
+    const TidyOptionImpl* option = option_defs;
+    const TidyOptionValue* value = &doc->config.value[ 0 ];
+    TidyConfigProfileImpl* profile = (TidyConfigProfileImpl*)
+        TidyDocAlloc( doc, sizeof(TidyConfigProfileImpl) );
+
+    profile->allocator = doc->counter.inner;  /* may outlive doc */
+    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    {
+        assert( ixVal == (uint) option->id );
+        if ( option->type == TidyString &&
+             value[ixVal].p && value[ixVal].p != option->pdflt )
+            profile->value[ixVal].p =
+                TY_(tmbstrdup)( profile->allocator, value[ixVal].p );
+        else
+            profile->value[ixVal] = value[ixVal];
+    }
+    return profile;
+}
+
+void TY_(FreeConfigProfile)( TidyConfigProfileImpl* profile )
+{
+    uint ixVal;
+    const TidyOptionImpl* option = option_defs;
+
+    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    {
+        if ( option->type == TidyString && profile->value[ixVal].p &&
+             profile->value[ixVal].p != option->pdflt )
+            TidyFree( profile->allocator, profile->value[ixVal].p );
+    }
+    TidyFree( profile->allocator, profile );
+}
+
+/* Like CopyConfig(), but without a source document; user tag
+** declarations are only parsed again if the profile changes them.
+*/
+void TY_(ApplyConfigProfile)( TidyDocImpl* doc,
+                              const TidyConfigProfileImpl* profile )
+{
+    uint ixVal;
+    const TidyOptionImpl* option = option_defs;
+    TidyOptionValue* value = &doc->config.value[ 0 ];
+    uint changedUserTags;
+    Bool needReparseTagsDecls = NeedReparseTagDecls( value, profile->value,
+                                                     &changedUserTags );
+
+    ResolveSnapshot( doc );
+    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    {
+        assert( ixVal == (uint) option->id );
+        if ( !OptionValueIdentical(option, &value[ixVal], &profile->value[ixVal]) )
+            CopyOptionValue( doc, option, &value[ixVal], &profile->value[ixVal] );
+    }
+    if ( needReparseTagsDecls )
+        ReparseTagDecls( doc, changedUserTags );
+    AdjustConfig( doc );  /* Make sure it's consistent */
+}
+
 
 #ifdef _DEBUG
 
@@ -1077,6 +1192,17 @@ void AdjustConfig( TidyDocImpl* doc )
         TY_(SetOptionBool)( doc, TidyQuoteAmpersand, yes );
         TY_(SetOptionBool)( doc, TidyHideEndTags, no );
     }
+
+    /* minified output: no indentation, wrapping or extra line breaks */
+    if ( cfgBool(doc, TidyMinify) )
+    {
+        TY_(SetOptionInt)( doc, TidyIndentContent, TidyNoState );
+        TY_(SetOptionInt)( doc, TidyIndentSpaces, 0 );
+        TY_(SetOptionBool)( doc, TidyIndentAttributes, no );
+        TY_(SetOptionInt)( doc, TidyWrapLen, 0x7FFFFFFF );
+        TY_(SetOptionInt)( doc, TidyVertSpace, TidyAutoState );
+        TY_(SetOptionBool)( doc, TidyBreakBeforeBR, no );
+    }
 }
 
 /* unsigned integers */
@@ -1543,9 +1669,9 @@ Bool ParseRepeatAttr( TidyDocImpl* doc, const TidyOptionImpl* option )
     buf[i] = '\0';
 
     if ( TY_(tmbstrcasecmp)(buf, "keep-first") == 0 )
-        cfg->value[ TidyDuplicateAttrs ].v = TidyKeepFirst;
+        TY_(SetOptionInt)( doc, TidyDuplicateAttrs, TidyKeepFirst );
     else if ( TY_(tmbstrcasecmp)(buf, "keep-last") == 0 )
-        cfg->value[ TidyDuplicateAttrs ].v = TidyKeepLast;
+        TY_(SetOptionInt)( doc, TidyDuplicateAttrs, TidyKeepLast );
     else
     {
         TY_(ReportBadArgument)( doc, option->name );
@@ -1571,9 +1697,9 @@ Bool ParseSorter( TidyDocImpl* doc, const TidyOptionImpl* option )
     buf[i] = '\0';
 
     if ( TY_(tmbstrcasecmp)(buf, "alpha") == 0 )
-        cfg->value[ TidySortAttributes ].v = TidySortAttrAlpha;
+        TY_(SetOptionInt)( doc, TidySortAttributes, TidySortAttrAlpha );
     else if ( TY_(tmbstrcasecmp)(buf, "none") == 0)
-        cfg->value[ TidySortAttributes ].v = TidySortAttrNone;
+        TY_(SetOptionInt)( doc, TidySortAttributes, TidySortAttrNone );
     else
     {
         TY_(ReportBadArgument)( doc, option->name );
@@ -1674,8 +1800,11 @@ static int  WriteOptionPick( const TidyOptionImpl* option, uint ival, StreamOut*
 
 Bool  TY_(ConfigDiffThanSnapshot)( TidyDocImpl* doc )
 {
-  int diff = memcmp( &doc->config.value, &doc->config.snapshot,
-                     N_TIDY_OPTIONS * sizeof(uint) );
+  int diff;
+  if ( doc->config.snapshotPending )
+      return no;
+  diff = memcmp( &doc->config.value, &doc->config.snapshot,
+                 N_TIDY_OPTIONS * sizeof(uint) );
   return ( diff != 0 );
 }
 
@@ -52,6 +52,7 @@ typedef struct _tidy_config
 {
     TidyOptionValue value[ N_TIDY_OPTIONS + 1 ];     /* current config values */
     TidyOptionValue snapshot[ N_TIDY_OPTIONS + 1 ];  /* Snapshot of values to be restored later */
+    Bool snapshotPending;  /* snapshot not copied yet, it equals value */
 
     /* track what tags user has defined to eliminate unnecessary searches */
     uint  defined_tags;
@@ -95,6 +96,13 @@ void TY_(ResetConfigToSnapshot)( TidyDocImpl* doc );
 
 void TY_(CopyConfig)( TidyDocImpl* docTo, TidyDocImpl* docFrom );
 
+typedef struct _TidyConfigProfileImpl TidyConfigProfileImpl;
+
+TidyConfigProfileImpl* TY_(NewConfigProfile)( TidyDocImpl* doc );
+void TY_(FreeConfigProfile)( TidyConfigProfileImpl* profile );
+void TY_(ApplyConfigProfile)( TidyDocImpl* doc,
+                              const TidyConfigProfileImpl* profile );
+
 int  TY_(ParseConfigFile)( TidyDocImpl* doc, ctmbstr cfgfil );
 int  TY_(ParseConfigFileEnc)( TidyDocImpl* doc,
                               ctmbstr cfgfil, ctmbstr charenc );
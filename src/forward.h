@@ -52,6 +52,17 @@ typedef struct _Lexer Lexer;
 
 extern TidyAllocator TY_(g_default_allocator);
 
+/* Forwards to another allocator, counting what is asked for */
+typedef struct _CountingAllocator
+{
+    TidyAllocator      base;
+    TidyAllocator*     inner;
+    unsigned long long count;
+    unsigned long long bytes;
+} CountingAllocator;
+
+void TY_(InitCountingAllocator)( CountingAllocator* counter, TidyAllocator* inner );
+
 /** Wrappers for easy memory allocation using an allocator */
 #define TidyAlloc(allocator, size) ((allocator)->vtbl->alloc((allocator), (size)))
 #define TidyRealloc(allocator, block, size) ((allocator)->vtbl->realloc((allocator), (block), (size)))
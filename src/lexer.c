@@ -39,6 +39,9 @@
 #include "clean.h"
 #include "utf8.h"
 #include "streamio.h"
+#if SUPPORT_THREADS
+#include <pthread.h>
+#endif
 #ifdef _MSC_VER
 #include "sprtf.h"
 #endif
@@ -761,24 +764,67 @@ static tmbchar LastChar( tmbstr str )
     #define StartEndTag 4
 */
 
+static void InitLexer( TidyDocImpl* doc, Lexer* lexer )
+{
+    TidyClearMemory( lexer, sizeof(Lexer) );
+
+    lexer->allocator = doc->allocator;
+    lexer->lines = 1;
+    lexer->columns = 1;
+    lexer->state = LEX_CONTENT;
+
+    lexer->versions = (VERS_ALL|VERS_PROPRIETARY);
+    lexer->doctype = VERS_UNKNOWN;
+    lexer->root = &doc->root;
+}
+
 Lexer* TY_(NewLexer)( TidyDocImpl* doc )
 {
     Lexer* lexer = (Lexer*) TidyDocAlloc( doc, sizeof(Lexer) );
 
     if ( lexer != NULL )
+        InitLexer( doc, lexer );
+    return lexer;
+}
+
+/* Releases what FreeLexer() would, but keeps the lexer itself and
+** the allocated character buffer and inline stack for the next
+** document.
+*/
+static void ClearLexer( TidyDocImpl* doc, Lexer* lexer )
+{
+    TY_(FreeStyles)( doc );
+
+    /* See GetToken() */
+    if ( lexer->pushed || lexer->itoken )
     {
-        TidyClearMemory( lexer, sizeof(Lexer) );
+        if (lexer->pushed)
+            TY_(FreeNode)( doc, lexer->itoken );
+        TY_(FreeNode)( doc, lexer->token );
+    }
 
-        lexer->allocator = doc->allocator;
-        lexer->lines = 1;
-        lexer->columns = 1;
-        lexer->state = LEX_CONTENT;
+    while ( lexer->istacksize > 0 )
+        TY_(PopInline)( doc, NULL );
+}
 
-        lexer->versions = (VERS_ALL|VERS_PROPRIETARY);
-        lexer->doctype = VERS_UNKNOWN;
-        lexer->root = &doc->root;
+void TY_(ResetLexer)( TidyDocImpl* doc )
+{
+    Lexer *lexer = doc->lexer;
+    if ( lexer )
+    {
+        tmbstr lexbuf = lexer->lexbuf;
+        uint lexlength = lexer->lexlength;
+        IStack* istack = lexer->istack;
+        uint istacklength = lexer->istacklength;
+
+        ClearLexer( doc, lexer );
+        InitLexer( doc, lexer );
+
+        lexer->lexbuf = lexbuf;
+        lexer->lexlength = lexlength;
+        lexer->istack = istack;
+        lexer->istacklength = istacklength;
     }
-    return lexer;
 }
 
 static Bool EndOfInput( TidyDocImpl* doc )
@@ -792,18 +838,7 @@ void TY_(FreeLexer)( TidyDocImpl* doc )
     Lexer *lexer = doc->lexer;
     if ( lexer )
     {
-        TY_(FreeStyles)( doc );
-
-        /* See GetToken() */
-        if ( lexer->pushed || lexer->itoken )
-        {
-            if (lexer->pushed)
-                TY_(FreeNode)( doc, lexer->itoken );
-            TY_(FreeNode)( doc, lexer->token );
-        }
-
-        while ( lexer->istacksize > 0 )
-            TY_(PopInline)( doc, NULL );
+        ClearLexer( doc, lexer );
 
         TidyDocFree( doc, lexer->istack );
         TidyDocFree( doc, lexer->lexbuf );
@@ -1163,6 +1198,7 @@ Node *TY_(NewNode)(TidyAllocator* allocator, Lexer *lexer)
     {
         node->line = lexer->lines;
         node->column = lexer->columns;
+        lexer->nodeCount++;
     }
     node->type = TextNode;
 #if !defined(NDEBUG) && defined(_MSC_VER) && defined(DEBUG_ALLOCATION)
@@ -1257,6 +1293,21 @@ void TY_(RemoveAttribute)( TidyDocImpl* doc, Node *node, AttVal *attr )
   through children. Set next to NULL before calling TY_(FreeNode)()
   to avoid freeing peer nodes. Doesn't patch up prev/next links.
  */
+/* Clears the pointers of the Find functions to a node being freed */
+static void ForgetNode( TidyDocImpl* doc, Node* node )
+{
+    if ( node == doc->doctypeNode )
+        doc->doctypeNode = NULL;
+    else if ( node == doc->htmlNode )
+        doc->htmlNode = NULL;
+    else if ( node == doc->headNode )
+        doc->headNode = NULL;
+    else if ( node == doc->titleNode )
+        doc->titleNode = NULL;
+    else if ( node == doc->bodyNode )
+        doc->bodyNode = NULL;
+}
+
 void TY_(FreeNode)( TidyDocImpl* doc, Node *node )
 {
 #if !defined(NDEBUG) && defined(_MSC_VER) && defined(DEBUG_ALLOCATION)
@@ -1273,6 +1324,8 @@ void TY_(FreeNode)( TidyDocImpl* doc, Node *node )
     {
         Node* next = node->next;
 
+        if ( doc )
+            ForgetNode( doc, node );
         TY_(FreeAttrs)( doc, node );
         TY_(FreeNode)( doc, node->content );
         TidyDocFree( doc, node->element );
@@ -1430,15 +1483,29 @@ void AddStringLiteralLen( Lexer* lexer, ctmbstr str, int len )
 }
 */
 
+/*
+  The Find functions remember what they found on the document.  A node
+  found before is returned again as long as it is still in its place,
+  which saves walking past e.g. comments ahead of the html element on
+  every call.  FreeNode() forgets the nodes it frees.
+*/
+
 /* find doctype element */
 Node *TY_(FindDocType)( TidyDocImpl* doc )
 {
     Node* node;
-    for ( node = (doc ? doc->root.content : NULL);
+
+    if ( !doc )
+        return NULL;
+    node = doc->doctypeNode;
+    if ( node && node->type == DocTypeTag && node->parent == &doc->root )
+        return node;
+
+    for ( node = doc->root.content;
           node && node->type != DocTypeTag; 
           node = node->next )
         /**/;
-    return node;
+    return doc->doctypeNode = node;
 }
 
 /* find parent container element */
@@ -1457,12 +1524,19 @@ Node* TY_(FindContainer)( Node* node )
 Node *TY_(FindHTML)( TidyDocImpl* doc )
 {
     Node *node;
-    for ( node = (doc ? doc->root.content : NULL);
+
+    if ( !doc )
+        return NULL;
+    node = doc->htmlNode;
+    if ( node && nodeIsHTML(node) && node->parent == &doc->root )
+        return node;
+
+    for ( node = doc->root.content;
           node && !nodeIsHTML(node); 
           node = node->next )
         /**/;
 
-    return node;
+    return doc->htmlNode = node;
 }
 
 /* find XML Declaration */
@@ -1480,14 +1554,20 @@ Node *TY_(FindXmlDecl)(TidyDocImpl* doc)
 
 Node *TY_(FindHEAD)( TidyDocImpl* doc )
 {
-    Node *node = TY_(FindHTML)( doc );
+    Node *html = TY_(FindHTML)( doc );
+    Node *node = NULL;
 
-    if ( node )
+    if ( html )
     {
-        for ( node = node->content;
+        node = doc->headNode;
+        if ( node && nodeIsHEAD(node) && node->parent == html )
+            return node;
+
+        for ( node = html->content;
               node && !nodeIsHEAD(node); 
               node = node->next )
             /**/;
+        doc->headNode = node;
     }
 
     return node;
@@ -1495,27 +1575,41 @@ Node *TY_(FindHEAD)( TidyDocImpl* doc )
 
 Node *TY_(FindTITLE)(TidyDocImpl* doc)
 {
-    Node *node = TY_(FindHEAD)(doc);
+    Node *head = TY_(FindHEAD)(doc);
+    Node *node = NULL;
+
+    if (head)
+    {
+        node = doc->titleNode;
+        if ( node && nodeIsTITLE(node) && node->parent == head )
+            return node;
 
-    if (node)
-        for (node = node->content;
+        for (node = head->content;
              node && !nodeIsTITLE(node);
              node = node->next) {}
+        doc->titleNode = node;
+    }
 
     return node;
 }
 
 Node *TY_(FindBody)( TidyDocImpl* doc )
 {
-    Node *node = ( doc ? doc->root.content : NULL );
-
-    while ( node && !nodeIsHTML(node) )
-        node = node->next;
+    Node *html = TY_(FindHTML)( doc );
+    Node *node;
 
-    if (node == NULL)
+    if (html == NULL)
         return NULL;
 
-    node = node->content;
+    node = doc->bodyNode;
+    if ( node && nodeIsBODY(node) && node->parent &&
+         ( node->parent == html ||
+           ( nodeIsNOFRAMES(node->parent) && node->parent->parent &&
+             nodeIsFRAMESET(node->parent->parent) &&
+             node->parent->parent->parent == html ) ) )
+        return node;
+
+    node = html->content;
     while ( node && !nodeIsBODY(node) && !nodeIsFRAMESET(node) )
         node = node->next;
 
@@ -1533,7 +1627,7 @@ Node *TY_(FindBody)( TidyDocImpl* doc )
         }
     }
 
-    return node;
+    return doc->bodyNode = node;
 }
 
 /* add meta element for Tidy */
@@ -1951,7 +2045,7 @@ Node* TY_(InferredTag)(TidyDocImpl* doc, TidyTagId id)
 {
     Lexer *lexer = doc->lexer;
     Node *node = TY_(NewNode)( lexer->allocator, lexer );
-    const Dict* dict = TY_(LookupTagDef)(id);
+    const Dict* dict = TY_(LookupTagDef)( doc, id );
 
     assert( dict != NULL );
 
@@ -2279,6 +2373,16 @@ Node* TY_(GetToken)( TidyDocImpl* doc, GetTokenMode mode )
         return node;
     }
 
+    /* past a resource limit or a cancel, the input ends here */
+    if ( doc->limitHit != TidyUnknownOption || TidyCancelled(doc) )
+        return NULL;
+    if ( cfg(doc, TidyMaxNodes) > 0 &&
+         lexer->nodeCount > cfg(doc, TidyMaxNodes) )
+    {
+        TY_(LimitExceeded)( doc, TidyMaxNodes );
+        return NULL;
+    }
+
     if (mode == CdataContent)
     {
         assert( lexer->parent != NULL );
@@ -2290,6 +2394,64 @@ Node* TY_(GetToken)( TidyDocImpl* doc, GetTokenMode mode )
     return GetTokenFromStream( doc, mode );
 }
 
+/*
+  Text is read as mixed content, or preformatted within pre, listing,
+  plaintext and xmp, and the content of script and style comes as a
+  single text token after the start tag.  Each token is freed once
+  the callback returns and the next one starts at the beginning of
+  the lexer buffer, so memory does not grow with the input.
+*/
+void TY_(Tokenize)( TidyDocImpl* doc, TidyTokenCallback callback )
+{
+    Lexer* lexer = doc->lexer;
+    uint pre = 0;
+    Node* node;
+
+    while ( (node = TY_(GetToken)(doc, pre ? Preformatted : MixedContent)) != NULL )
+    {
+        Node* cdata = NULL;
+        Bool more;
+
+        if ( node->tag && node->type == StartTag )
+        {
+            if ( node->tag->parser == TY_(ParseScript) )
+            {
+                lexer->parent = node;
+                cdata = TY_(GetToken)( doc, CdataContent );
+                lexer->parent = NULL;
+            }
+            else if ( node->tag->parser == TY_(ParsePre) )
+                ++pre;
+        }
+        else if ( node->tag && node->type == EndTag &&
+                  node->tag->parser == TY_(ParsePre) && pre > 0 )
+            --pre;
+
+        /* text may end up empty, e.g. white space at the end */
+        more = ( node->type == TextNode && node->end <= node->start ) ||
+               callback( tidyImplToDoc(doc), tidyImplToNode(node) );
+        if ( more && cdata && cdata->end > cdata->start )
+            more = callback( tidyImplToDoc(doc), tidyImplToNode(cdata) );
+
+        TY_(FreeNode)( doc, cdata );
+        TY_(FreeNode)( doc, node );
+        lexer->token = NULL;
+        lexer->lexsize = lexer->txtstart = lexer->txtend = 0;
+
+        if ( !more )
+            break;
+    }
+}
+
+void TY_(LimitExceeded)( TidyDocImpl* doc, TidyOptionId optId )
+{
+    if ( doc->limitHit == TidyUnknownOption )
+    {
+        TY_(ReportLimitExceeded)( doc, optId );
+        doc->limitHit = optId;
+    }
+}
+
 #if !defined(NDEBUG) && defined(_MSC_VER)
 static void check_me(char *name)
 {
@@ -3209,7 +3371,7 @@ static void MapStr( ctmbstr str, uint code )
     }
 }
 
-void TY_(InitMap)(void)
+static void FillMap(void)
 {
     MapStr("\r\n\f", newline|white);
     MapStr(" \t", white);
@@ -3220,6 +3382,18 @@ void TY_(InitMap)(void)
     MapStr("abcdefABCDEF", digithex);
 }
 
+/* set up by the first document, only read after that */
+void TY_(InitMap)(void)
+{
+#if SUPPORT_THREADS
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once( &once, FillMap );
+#else
+    if ( lexmap['a'] == 0 )
+        FillMap();
+#endif
+}
+
 /*
  parser for ASP within start tags
 
@@ -3916,12 +4090,22 @@ static AttVal* ParseAttrs( TidyDocImpl* doc, Bool *isempty )
     tmbstr value;
     int delim;
     Node *asp, *php;
+    uint count = 0, max = cfg( doc, TidyMaxAttributes );
 
     list = NULL;
 
     while ( !EndOfInput(doc) )
     {
-        tmbstr attribute = ParseAttribute( doc, isempty, &asp, &php );
+        tmbstr attribute;
+
+        /* stop past the limit, but let exactly max attributes through */
+        if ( max > 0 && count > max )
+        {
+            TY_(LimitExceeded)( doc, TidyMaxAttributes );
+            break;
+        }
+
+        attribute = ParseAttribute( doc, isempty, &asp, &php );
 
         if (attribute == NULL)
         {
@@ -3931,6 +4115,7 @@ static AttVal* ParseAttrs( TidyDocImpl* doc, Bool *isempty )
                 av = TY_(NewAttribute)(doc);
                 av->asp = asp;
                 AddAttrToList( &list, av ); 
+                ++count;
                 continue;
             }
 
@@ -3940,6 +4125,7 @@ static AttVal* ParseAttrs( TidyDocImpl* doc, Bool *isempty )
                 av = TY_(NewAttribute)(doc);
                 av->php = php;
                 AddAttrToList( &list, av ); 
+                ++count;
                 continue;
             }
 
@@ -3957,6 +4143,7 @@ static AttVal* ParseAttrs( TidyDocImpl* doc, Bool *isempty )
             av->value = value;
             av->dict = TY_(FindAttribute)( doc, av );
             AddAttrToList( &list, av ); 
+            ++count;
         }
         else
         {
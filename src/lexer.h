@@ -228,6 +228,12 @@ struct _Style
     tmbstr tag_class;
     tmbstr properties;
     TagStyle *next;
+    TagStyle *hashNext;        /* chain in Lexer styleHash */
+};
+
+enum
+{
+    STYLE_HASH_SIZE=1021u
 };
 
 
@@ -387,6 +393,12 @@ struct _Lexer
     uint istackbase;        /* start of frame */
 
     TagStyle *styles;          /* used for cleaning up presentation markup */
+    TagStyle **styleHash;      /* the same by tag and properties, or NULL */
+
+    Node* context;          /* element a fragment is parsed into */
+
+    uint nodeCount;         /* nodes created, for max-nodes */
+    uint depth;             /* element parsers running, for max-depth */
 
     TidyAllocator* allocator; /* allocator */
 
@@ -423,6 +435,7 @@ uint TY_(ToUpper)(uint c);
 
 Lexer* TY_(NewLexer)( TidyDocImpl* doc );
 void TY_(FreeLexer)( TidyDocImpl* doc );
+void TY_(ResetLexer)( TidyDocImpl* doc );
 
 /* store character c as UTF-8 encoded byte stream */
 void TY_(AddCharToLexer)( Lexer *lexer, uint c );
@@ -531,6 +544,14 @@ typedef enum
 
 Node* TY_(GetToken)( TidyDocImpl* doc, GetTokenMode mode );
 
+/* Reads the rest of the input token by token, handing each token to
+** the callback instead of building a tree.
+*/
+void TY_(Tokenize)( TidyDocImpl* doc, TidyTokenCallback callback );
+
+/* Reports the limit and makes GetToken() act as at the end of input */
+void TY_(LimitExceeded)( TidyDocImpl* doc, TidyOptionId optId );
+
 void TY_(InitMap)(void);
 
 
@@ -15,6 +15,9 @@
 #include "message.h"
 #include "tmbstr.h"
 #include "utf8.h"
+#if SUPPORT_THREADS
+#include <pthread.h>
+#endif
 #if !defined(NDEBUG) && defined(_MSC_VER)
 #include "sprtf.h"
 #endif
@@ -41,6 +44,12 @@ ctmbstr TIDY_CALL     tidyLibraryVersion(void)
 }
 
 
+#if SUPPORT_ACCESSIBILITY_CHECKS
+#define N_MESSAGE_CODES LAST_ACCESS_ERR
+#else
+#define N_MESSAGE_CODES (HIDDEN_REPEATS + 1)
+#endif
+
 static struct _msgfmt
 {
     uint code;
@@ -169,6 +178,10 @@ static struct _msgfmt
 
 /* */
   { PREVIOUS_LOCATION,            "<%s> previously mentioned"                                               }, /* Info */
+  { LIMIT_EXCEEDED,               "document exceeds %s %lu, parsing stopped"                                }, /* Error */
+
+/* ErrorSummary */
+  { HIDDEN_REPEATS,               "%u more of this kind were not shown: %s"                                 }, /* Summary */
 
 #if SUPPORT_ACCESSIBILITY_CHECKS
 
@@ -307,15 +320,15 @@ static struct _msgfmt
   { 0,                                             NULL                                                                       }
 };
 
+/* msgFormat and option_docs indexed by code and option id,
+** filled in once by InitMessages()
+*/
+static ctmbstr msgFormatByCode[N_MESSAGE_CODES];
+static const TidyOptionDoc* optionDocById[N_TIDY_OPTIONS];
+
 static ctmbstr GetFormatFromCode(uint code)
 {
-    uint i;
-
-    for (i = 0; msgFormat[i].fmt; ++i)
-        if (msgFormat[i].code == code)
-            return msgFormat[i].fmt;
-
-    return NULL;
+    return code < N_MESSAGE_CODES ? msgFormatByCode[code] : NULL;
 }
 
 /*
@@ -367,6 +380,8 @@ static const TidyOptionId TidyNumEntitiesLinks[] =
   { TidyDoctype, TidyPreserveEntities, TidyUnknownOption };
 static const TidyOptionId TidyDropFontTagsLinks[] =
   { TidyMakeClean, TidyUnknownOption };
+static const TidyOptionId TidyMinifyLinks[] =
+  { TidyOmitOptionalTags, TidyVertSpace, TidyWrapLen, TidyUnknownOption };
 
 /* Documentation of options 
 ** As of 2015-October these descriptions are used uniquely by
@@ -1104,6 +1119,68 @@ static const TidyOptionDoc option_docs[] =
    "This option specifies that Tidy should skip nested tags when parsing "
    "script and style data. "
   },
+  {TidyPrintThreads,
+   "This option specifies the number of threads Tidy uses to pretty print "
+   "the block-level content of <code>&lt;body&gt;</code>. Each thread renders "
+   "a run of top-level blocks into its own buffer and the results are "
+   "written out in document order, so the output is identical to a "
+   "sequential run. "
+   "<br/>"
+   "A value of <code>0</code> or <code>1</code> prints on the calling thread. "
+   "The option has no effect for XML output, when a progress callback is "
+   "installed, or if Tidy was built without thread support. "
+   "<br/>"
+   "When set, any custom allocator must be safe to call from several threads. "
+  },
+  {TidyMinify,
+   "This option specifies if Tidy should make the output as compact as "
+   "possible, e.g. for serving it. "
+   "<br/>"
+   "Setting it to <code>yes</code> turns off indentation, wrapping and the "
+   "line breaks between elements (content of <code>&lt;pre&gt;</code>, "
+   "<code>&lt;textarea&gt;</code>, scripts and styles is left alone), "
+   "and for HTML output also omits the optional tags whose omission "
+   "HTML5 allows in their context, so the output parses to the same tree, "
+   "leaves attribute values "
+   "unquoted where that is valid or otherwise uses the quote mark needing "
+   "fewer escapes, and drops values that only repeat the attribute name of "
+   "a boolean attribute or are empty. "
+   ,TidyMinifyLinks
+  },
+  {TidyShowRepeats,
+   "This option specifies how many messages with the same message code Tidy "
+   "shows. Further ones are only counted, and the error summary says how "
+   "many of each kind were left out. "
+   "<br/>"
+   "The default of <code>0</code> shows all of them. "
+  },
+  {TidyMaxInputSize,
+   "This option sets the most bytes of input Tidy reads for a document. "
+   "Tidy stops parsing when the input is longer, reports an error and "
+   "returns -E2BIG. "
+   "<br/>"
+   "The default of <code>0</code> means no limit. "
+  },
+  {TidyMaxNodes,
+   "This option sets the most nodes Tidy creates while parsing a document. "
+   "Tidy stops parsing when there are more, reports an error and returns "
+   "-E2BIG. "
+   "<br/>"
+   "The default of <code>0</code> means no limit. "
+  },
+  {TidyMaxDepth,
+   "This option sets how deep elements may be nested in a document. "
+   "Tidy stops parsing at an element nested deeper, reports an error and "
+   "returns -E2BIG. "
+   "<br/>"
+   "The default of <code>0</code> means no limit. "
+  },
+  {TidyMaxAttributes,
+   "This option sets the most attributes one element may have. Tidy stops "
+   "parsing at an element with more, reports an error and returns -E2BIG. "
+   "<br/>"
+   "The default of <code>0</code> means no limit. "
+  },
   {N_TIDY_OPTIONS,
    NULL
   }
@@ -1111,15 +1188,43 @@ static const TidyOptionDoc option_docs[] =
 
 const TidyOptionDoc* TY_(OptGetDocDesc)( TidyOptionId optId )
 {
-    uint i = 0;
+    if ( (uint) optId < N_TIDY_OPTIONS )
+        return optionDocById[ optId ];
+    return NULL;
+}
 
-    while( option_docs[i].opt != N_TIDY_OPTIONS )
+static void FillMessageIndex(void)
+{
+    uint i;
+
+    /* the first entry for a code wins, as with a linear search */
+    for ( i = 0; msgFormat[i].fmt; ++i )
+        if ( msgFormat[i].code < N_MESSAGE_CODES &&
+             msgFormatByCode[ msgFormat[i].code ] == NULL )
+            msgFormatByCode[ msgFormat[i].code ] = msgFormat[i].fmt;
+
+    for ( i = 0; option_docs[i].opt != N_TIDY_OPTIONS; ++i )
+        if ( optionDocById[ option_docs[i].opt ] == NULL )
+            optionDocById[ option_docs[i].opt ] = &option_docs[i];
+}
+
+/* Documents may be created on several threads at once, so the
+** index is filled by the first caller only.  Without thread support
+** the library starts no threads of its own.
+*/
+void TY_(InitMessages)(void)
+{
+#if SUPPORT_THREADS
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once( &once, FillMessageIndex );
+#else
+    static Bool filled = no;
+    if ( !filled )
     {
-        if ( option_docs[i].opt == optId )
-            return &option_docs[i];
-        ++i;
+        FillMessageIndex();
+        filled = yes;
     }
-    return NULL;
+#endif
 }
 
 
@@ -1191,6 +1296,74 @@ static Bool UpdateCount( TidyDocImpl* doc, TidyReportLevel level )
   return go;
 }
 
+/* Counts the messages with the given code when show-repeats is set,
+** returns yes once the limit is exceeded.
+*/
+static Bool RepeatLimitReached( TidyDocImpl* doc, uint code )
+{
+    uint limit = cfg( doc, TidyShowRepeats );
+
+    if ( limit == 0 || code >= N_MESSAGE_CODES )
+        return no;
+
+    if ( !doc->mssgRepeats )
+    {
+        doc->mssgRepeats = (uint*) TidyDocAlloc( doc, N_MESSAGE_CODES * sizeof(uint) );
+        TidyClearMemory( doc->mssgRepeats, N_MESSAGE_CODES * sizeof(uint) );
+    }
+    return ++doc->mssgRepeats[code] > limit;
+}
+
+void TY_(ResetMessageRepeats)( TidyDocImpl* doc )
+{
+    if ( doc->mssgRepeats )
+        TidyClearMemory( doc->mssgRepeats, N_MESSAGE_CODES * sizeof(uint) );
+}
+
+/* Number of messages left out because of show-repeats */
+static uint HiddenRepeats( TidyDocImpl* doc )
+{
+    uint code, limit = cfg( doc, TidyShowRepeats ), hidden = 0;
+
+    if ( doc->mssgRepeats )
+        for ( code = 0; code < N_MESSAGE_CODES; ++code )
+            if ( doc->mssgRepeats[code] > limit )
+                hidden += doc->mssgRepeats[code] - limit;
+    return hidden;
+}
+
+/* Lets the reporting functions skip building the arguments of a
+** message (tag descriptions etc.) that will neither be displayed
+** nor passed to a filter; such a message is just counted.  Otherwise
+** counting is left to messagePos().  Must agree with UpdateCount().
+*/
+static Bool SkipMessage( TidyDocImpl* doc, uint code, TidyReportLevel level )
+{
+    Bool go = ( doc->errors < cfg(doc, TidyShowErrors) );
+
+    /* what follows a resource limit or a cancel is of no interest,
+       not even counted */
+    if ( doc->limitHit != TidyUnknownOption || doc->cancelled )
+        return yes;
+    if ( level == TidyWarning )
+        go = go && cfgBool( doc, TidyShowWarnings );
+    if ( go && !RepeatLimitReached(doc, code) )
+        return no;
+    UpdateCount( doc, level );
+    return yes;
+}
+
+/* Notes code, element and attribute of the message about to be
+** reported, for the record filter.  messagePos() picks them up
+** and clears them again.
+*/
+static void RecordMessage( TidyDocImpl* doc, uint code, Node* node, AttVal* av )
+{
+    doc->mssgRec.code = code;
+    doc->mssgRec.tagId = ( node && node->tag ) ? node->tag->id : TidyTag_UNKNOWN;
+    doc->mssgRec.attrId = ( av && av->dict ) ? av->dict->id : TidyAttr_UNKNOWN;
+}
+
 static char* ReportPosition(TidyDocImpl* doc, int line, int col, char* buf, size_t count)
 {
     *buf = 0;
@@ -1225,24 +1398,49 @@ static void messagePos( TidyDocImpl* doc, TidyReportLevel level,
                         int line, int col, ctmbstr msg, va_list args )
 {
     enum { sizeMessageBuf=2048 };
-    char *messageBuf = TidyDocAlloc(doc,sizeMessageBuf);
+    char *messageBuf = NULL;
     Bool go = UpdateCount( doc, level );
+    TidyMessageRecord rec = doc->mssgRec;
+
+    doc->mssgRec.code = 0;
+    doc->mssgRec.tagId = TidyTag_UNKNOWN;
+    doc->mssgRec.attrId = TidyAttr_UNKNOWN;
+
+    if ( go && doc->mssgRecFilt )
+    {
+        rec.level = level;
+        rec.line = line > 0 ? (uint) line : 0;
+        rec.column = col > 0 ? (uint) col : 0;
+        go = doc->mssgRecFilt( tidyImplToDoc(doc), &rec );
+    }
 
+    /* The text is only formatted once somebody needs it: a filter
+    ** taking the formatted message, or the error output.
+    */
     if ( go )
     {
         va_list args_copy;
         va_copy(args_copy, args);
-        TY_(tmbvsnprintf)(messageBuf, sizeMessageBuf, msg, args);
         if ( doc->mssgFilt )
         {
             TidyDoc tdoc = tidyImplToDoc( doc );
+            messageBuf = TidyDocAlloc(doc,sizeMessageBuf);
+            TY_(tmbvsnprintf)(messageBuf, sizeMessageBuf, msg, args);
             go = doc->mssgFilt( tdoc, level, line, col, messageBuf );
         }
-        if ( doc->mssgFilt2 )
+        if ( go && doc->mssgFilt2 )
         {
             TidyDoc tdoc = tidyImplToDoc( doc );
-            go = go | doc->mssgFilt2( tdoc, level, line, col, msg, args_copy );
+            go = doc->mssgFilt2( tdoc, level, line, col, msg, args_copy );
         }
+        va_end(args_copy);
+    }
+
+    /* args is still untouched unless mssgFilt formatted it already */
+    if ( go && messageBuf == NULL )
+    {
+        messageBuf = TidyDocAlloc(doc,sizeMessageBuf);
+        TY_(tmbvsnprintf)(messageBuf, sizeMessageBuf, msg, args);
     }
 
     if ( go )
@@ -1274,7 +1472,8 @@ static void messagePos( TidyDocImpl* doc, TidyReportLevel level,
 #endif
         TidyDocFree(doc, buf);
     }
-    TidyDocFree(doc, messageBuf);
+    if ( messageBuf )
+        TidyDocFree(doc, messageBuf);
 }
 
 /* Reports error at current Lexer line/column. */ 
@@ -1460,6 +1659,7 @@ void TY_(ReportEncodingWarning)(TidyDocImpl* doc, uint code, uint encoding)
     switch(code)
     {
     case ENCODING_MISMATCH:
+        RecordMessage( doc, code, NULL, NULL );
         messageLexer(doc, TidyWarning, GetFormatFromCode(code), 
                      TY_(CharEncodingName)(doc->docIn->encoding),
                      TY_(CharEncodingName)(encoding));
@@ -1506,8 +1706,23 @@ void TY_(ReportEncodingError)(TidyDocImpl* doc, uint code, uint c, Bool discarde
         break;
     }
 
-    if (fmt)
+    if ( fmt && !SkipMessage(doc, code, TidyWarning) )
+    {
+        RecordMessage( doc, code, NULL, NULL );
         messageLexer( doc, TidyWarning, fmt, action, buf );
+    }
+}
+
+void TY_(ReportLimitExceeded)( TidyDocImpl* doc, TidyOptionId optId )
+{
+    const TidyOptionImpl* option = TY_(getOption)( optId );
+    ctmbstr fmt = GetFormatFromCode(LIMIT_EXCEEDED);
+
+    if ( fmt && !SkipMessage(doc, LIMIT_EXCEEDED, TidyError) )
+    {
+        RecordMessage( doc, LIMIT_EXCEEDED, NULL, NULL );
+        messageLexer( doc, TidyError, fmt, option->name, cfg(doc, optId) );
+    }
 }
 
 void TY_(ReportEntityError)( TidyDocImpl* doc, uint code, ctmbstr entity,
@@ -1516,17 +1731,28 @@ void TY_(ReportEntityError)( TidyDocImpl* doc, uint code, ctmbstr entity,
     ctmbstr entityname = ( entity ? entity : "NULL" );
     ctmbstr fmt = GetFormatFromCode(code);
 
-    if (fmt)
+    if ( fmt && !SkipMessage(doc, code, TidyWarning) )
+    {
+        RecordMessage( doc, code, NULL, NULL );
         messageLexer( doc, TidyWarning, fmt, entityname );
+    }
 }
 
 void TY_(ReportAttrError)(TidyDocImpl* doc, Node *node, AttVal *av, uint code)
 {
     char const *name = "NULL", *value = "NULL";
     char tagdesc[64];
-    ctmbstr fmt = GetFormatFromCode(code);
+    ctmbstr fmt;
+
+    if (code == MISSING_IMAGEMAP)
+        doc->badAccess |= BA_MISSING_IMAGE_MAP;
 
+    if ( SkipMessage(doc, code, TidyWarning) )
+        return;
+
+    fmt = GetFormatFromCode(code);
     assert( fmt != NULL );
+    RecordMessage( doc, code, node, av );
 
     TagToString(node, tagdesc, sizeof(tagdesc));
 
@@ -1581,7 +1807,6 @@ void TY_(ReportAttrError)(TidyDocImpl* doc, Node *node, AttVal *av, uint code)
 
     case MISSING_IMAGEMAP:
         messageNode(doc, TidyWarning, node, fmt, tagdesc);
-        doc->badAccess |= BA_MISSING_IMAGE_MAP;
         break;
 
     case REPEATED_ATTRIBUTE:
@@ -1600,9 +1825,18 @@ void TY_(ReportAttrError)(TidyDocImpl* doc, Node *node, AttVal *av, uint code)
 void TY_(ReportMissingAttr)( TidyDocImpl* doc, Node* node, ctmbstr name )
 {
     char tagdesc[ 64 ];
-    ctmbstr fmt = GetFormatFromCode(MISSING_ATTRIBUTE);
+    ctmbstr fmt;
+    AttVal av;
 
+    if ( SkipMessage(doc, MISSING_ATTRIBUTE, TidyWarning) )
+        return;
+
+    fmt = GetFormatFromCode(MISSING_ATTRIBUTE);
     assert( fmt != NULL );
+    TidyClearMemory( &av, sizeof(av) );
+    av.attribute = (tmbstr) name;
+    av.dict = TY_(FindAttribute)( doc, &av );
+    RecordMessage( doc, MISSING_ATTRIBUTE, node, &av );
     TagToString(node, tagdesc, sizeof(tagdesc));
     messageNode( doc, TidyWarning, node, fmt, tagdesc, name );
 }
@@ -1641,16 +1875,20 @@ void TY_(DisplayHTMLTableAlgorithm)( TidyDocImpl* doc )
 
 void TY_(ReportAccessWarning)( TidyDocImpl* doc, Node* node, uint code )
 {
-    ctmbstr fmt = GetFormatFromCode(code);
     doc->badAccess |= BA_WAI;
-    messageNode( doc, TidyAccess, node, "%s", fmt );
+    if ( SkipMessage(doc, code, TidyAccess) )
+        return;
+    RecordMessage( doc, code, node, NULL );
+    messageNode( doc, TidyAccess, node, "%s", GetFormatFromCode(code) );
 }
 
 void TY_(ReportAccessError)( TidyDocImpl* doc, Node* node, uint code )
 {
-    ctmbstr fmt = GetFormatFromCode(code);
     doc->badAccess |= BA_WAI;
-    messageNode( doc, TidyAccess, node, "%s", fmt );
+    if ( SkipMessage(doc, code, TidyAccess) )
+        return;
+    RecordMessage( doc, code, node, NULL );
+    messageNode( doc, TidyAccess, node, "%s", GetFormatFromCode(code) );
 }
 
 #endif /* SUPPORT_ACCESSIBILITY_CHECKS */
@@ -1658,11 +1896,17 @@ void TY_(ReportAccessError)( TidyDocImpl* doc, Node* node, uint code )
 void TY_(ReportWarning)(TidyDocImpl* doc, Node *element, Node *node, uint code)
 {
     Node* rpt = (element ? element : node);
-    ctmbstr fmt = GetFormatFromCode(code);
-    char nodedesc[256] = { 0 };
-    char elemdesc[256] = { 0 };
+    ctmbstr fmt;
+    char nodedesc[256];
+    char elemdesc[256];
+
+    if ( SkipMessage(doc, code, TidyWarning) )
+        return;
 
+    fmt = GetFormatFromCode(code);
     assert( fmt != NULL );
+    nodedesc[0] = elemdesc[0] = '\0';
+    RecordMessage( doc, code, rpt, NULL );
 
     TagToString(node, nodedesc, sizeof(nodedesc));
 
@@ -1693,11 +1937,17 @@ void TY_(ReportWarning)(TidyDocImpl* doc, Node *element, Node *node, uint code)
 void TY_(ReportNotice)(TidyDocImpl* doc, Node *element, Node *node, uint code)
 {
     Node* rpt = ( element ? element : node );
-    ctmbstr fmt = GetFormatFromCode(code);
-    char nodedesc[256] = { 0 };
-    char elemdesc[256] = { 0 };
+    ctmbstr fmt;
+    char nodedesc[256];
+    char elemdesc[256];
+
+    if ( SkipMessage(doc, code, TidyWarning) )
+        return;
 
+    fmt = GetFormatFromCode(code);
     assert( fmt != NULL );
+    nodedesc[0] = elemdesc[0] = '\0';
+    RecordMessage( doc, code, rpt, NULL );
 
     TagToString(node, nodedesc, sizeof(nodedesc));
 
@@ -1717,12 +1967,56 @@ void TY_(ReportNotice)(TidyDocImpl* doc, Node *element, Node *node, uint code)
 
 void TY_(ReportError)(TidyDocImpl* doc, Node *element, Node *node, uint code)
 {
-    char nodedesc[ 256 ] = {0};
-    char elemdesc[ 256 ] = {0};
+    char nodedesc[ 256 ];
+    char elemdesc[ 256 ];
     Node* rpt = ( element ? element : node );
-    ctmbstr fmt = GetFormatFromCode(code);
+    ctmbstr fmt;
+    TidyReportLevel level = TidyWarning;
+    Node* mentionAt = NULL; /* where to say element was mentioned before */
 
+    /* the context of a fragment is not in the input to be closed */
+    if ( code == MISSING_ENDTAG_FOR && element && doc->lexer &&
+         element == doc->lexer->context )
+        return;
+
+    switch ( code )
+    {
+    case REMOVED_HTML5:
+        level = TidyError;
+        break;
+
+    case DISCARDING_UNEXPECTED:
+        /* Force error if in a bad form, or
+           Issue #166 - repeated <main> element
+        */
+        if ( doc->badForm )
+            level = TidyError;
+        break;
+
+    case UNEXPECTED_ENDTAG_IN:
+    case TOO_MANY_ELEMENTS_IN:
+        mentionAt = node;
+        break;
+
+    case TAG_NOT_ALLOWED_IN:
+        mentionAt = element;
+        break;
+    }
+    if ( !cfgBool(doc, TidyShowWarnings) )
+        mentionAt = NULL;
+
+    if ( SkipMessage(doc, code, level) )
+    {
+        /* still count the accompanying "previously mentioned" info */
+        if ( mentionAt )
+            UpdateCount( doc, TidyInfo );
+        return;
+    }
+
+    fmt = GetFormatFromCode(code);
     assert( fmt != NULL );
+    nodedesc[0] = elemdesc[0] = '\0';
+    RecordMessage( doc, code, rpt, NULL );
 
     TagToString(node, nodedesc, sizeof(nodedesc));
 
@@ -1732,7 +2026,7 @@ void TY_(ReportError)(TidyDocImpl* doc, Node *element, Node *node, uint code)
     case UNEXPECTED_ENDTAG:
     case TOO_MANY_ELEMENTS:
     case INSERTING_TAG:
-        messageNode(doc, TidyWarning, node, fmt, node->element);
+        messageNode(doc, level, node, fmt, node->element);
         break;
 
     case USING_BR_INPLACE_OF:
@@ -1740,7 +2034,7 @@ void TY_(ReportError)(TidyDocImpl* doc, Node *element, Node *node, uint code)
     case PROPRIETARY_ELEMENT:
     case UNESCAPED_ELEMENT:
     case NOFRAMES_CONTENT:
-        messageNode(doc, TidyWarning, node, fmt, nodedesc);
+        messageNode(doc, level, node, fmt, nodedesc);
         break;
 
     case MISSING_TITLE_ELEMENT:
@@ -1754,26 +2048,23 @@ void TY_(ReportError)(TidyDocImpl* doc, Node *element, Node *node, uint code)
     case INCONSISTENT_NAMESPACE:
     case DOCTYPE_AFTER_TAGS:
     case DTYPE_NOT_UPPER_CASE:
-        messageNode(doc, TidyWarning, rpt, "%s", fmt);
+        messageNode(doc, level, rpt, "%s", fmt);
         break;
 
     case COERCE_TO_ENDTAG:
     case NON_MATCHING_ENDTAG:
-        messageNode(doc, TidyWarning, rpt, fmt, node->element, node->element);
+        messageNode(doc, level, rpt, fmt, node->element, node->element);
         break;
 
     case UNEXPECTED_ENDTAG_IN:
     case TOO_MANY_ELEMENTS_IN:
-        messageNode(doc, TidyWarning, node, fmt, node->element, element->element);
-        if (cfgBool( doc, TidyShowWarnings ))
-            messageNode(doc, TidyInfo, node, GetFormatFromCode(PREVIOUS_LOCATION),
-                        element->element);
+        messageNode(doc, level, node, fmt, node->element, element->element);
         break;
 
     case ENCODING_IO_CONFLICT:
     case MISSING_DOCTYPE:
     case SPACE_PRECEDING_XMLDECL:
-        messageNode(doc, TidyWarning, node, "%s", fmt);
+        messageNode(doc, level, node, "%s", fmt);
         break;
 
     case TRIM_EMPTY_ELEMENT:
@@ -1781,47 +2072,55 @@ void TY_(ReportError)(TidyDocImpl* doc, Node *element, Node *node, uint code)
     case UNEXPECTED_END_OF_FILE:
     case ELEMENT_NOT_EMPTY:
         TagToString(element, elemdesc, sizeof(elemdesc));
-        messageNode(doc, TidyWarning, element, fmt, elemdesc);
+        messageNode(doc, level, element, fmt, elemdesc);
         break;
 
 
     case MISSING_ENDTAG_FOR:
-        messageNode(doc, TidyWarning, rpt, fmt, element->element);
+        messageNode(doc, level, rpt, fmt, element->element);
         break;
 
     case MISSING_ENDTAG_BEFORE:
-        messageNode(doc, TidyWarning, rpt, fmt, element->element, nodedesc);
+        messageNode(doc, level, rpt, fmt, element->element, nodedesc);
         break;
 
     case DISCARDING_UNEXPECTED:
-        /* Force error if in a bad form, or 
-           Issue #166 - repeated <main> element
-        */
-        messageNode(doc, doc->badForm ? TidyError : TidyWarning, node, fmt, nodedesc);
+        messageNode(doc, level, node, fmt, nodedesc);
         break;
 
     case TAG_NOT_ALLOWED_IN:
-        messageNode(doc, TidyWarning, node, fmt, nodedesc, element->element);
-        if (cfgBool( doc, TidyShowWarnings ))
-            messageNode(doc, TidyInfo, element,
-                        GetFormatFromCode(PREVIOUS_LOCATION), element->element);
+        messageNode(doc, level, node, fmt, nodedesc, element->element);
         break;
 
     case REPLACING_UNEX_ELEMENT:
         TagToString(element, elemdesc, sizeof(elemdesc));
-        messageNode(doc, TidyWarning, rpt, fmt, elemdesc, nodedesc);
+        messageNode(doc, level, rpt, fmt, elemdesc, nodedesc);
         break;
     case REMOVED_HTML5:
-        messageNode(doc, TidyError, rpt, fmt, nodedesc);
+        messageNode(doc, level, rpt, fmt, nodedesc);
         break;
     }
+
+    if ( mentionAt )
+    {
+        RecordMessage( doc, PREVIOUS_LOCATION, element, NULL );
+        messageNode(doc, TidyInfo, mentionAt,
+                    GetFormatFromCode(PREVIOUS_LOCATION), element->element);
+    }
 }
 
 void TY_(ReportFatal)( TidyDocImpl* doc, Node *element, Node *node, uint code)
 {
-    char nodedesc[ 256 ] = {0};
+    char nodedesc[ 256 ];
     Node* rpt = ( element ? element : node );
-    ctmbstr fmt = GetFormatFromCode(code);
+    ctmbstr fmt;
+
+    if ( SkipMessage(doc, code, TidyError) )
+        return;
+
+    fmt = GetFormatFromCode(code);
+    nodedesc[0] = '\0';
+    RecordMessage( doc, code, rpt, NULL );
 
     switch ( code )
     {
@@ -1845,6 +2144,36 @@ void TY_(ReportFatal)( TidyDocImpl* doc, Node *element, Node *node, uint code)
     }
 }
 
+/* Copies a message format with each placeholder shown as "...",
+** for naming a kind of message in the summary.
+*/
+static void DescribeFormat( ctmbstr fmt, tmbstr buf, uint count )
+{
+    uint n = 0;
+
+    while ( *fmt && n + 4 < count )
+    {
+        if ( *fmt != '%' )
+        {
+            buf[n++] = *fmt++;
+            continue;
+        }
+        if ( *++fmt == '%' )
+        {
+            buf[n++] = *fmt++;
+            continue;
+        }
+        while ( *fmt && strchr("-+ #0123456789.lh", *fmt) )
+            ++fmt;
+        if ( *fmt )
+            ++fmt;
+        buf[n++] = '.';
+        buf[n++] = '.';
+        buf[n++] = '.';
+    }
+    buf[n] = '\0';
+}
+
 void TY_(ErrorSummary)( TidyDocImpl* doc )
 {
     ctmbstr encnam = "specified";
@@ -1865,6 +2194,24 @@ void TY_(ErrorSummary)( TidyDocImpl* doc )
             doc->badAccess &= ~(BA_USING_FRAMES | BA_USING_NOFRAMES);
     }
 
+    if ( HiddenRepeats(doc) > 0 )
+    {
+        uint code, limit = cfg( doc, TidyShowRepeats );
+        for ( code = 0; code < N_MESSAGE_CODES; ++code )
+        {
+            ctmbstr fmt;
+            tmbchar desc[ 256 ];
+            if ( doc->mssgRepeats[code] <= limit ||
+                 (fmt = GetFormatFromCode(code)) == NULL )
+                continue;
+            DescribeFormat( fmt, desc, sizeof(desc) );
+            tidy_out( doc, GetFormatFromCode(HIDDEN_REPEATS),
+                      doc->mssgRepeats[code] - limit, desc );
+            tidy_out( doc, "\n" );
+        }
+        tidy_out( doc, "\n" );
+    }
+
     if (doc->badChars)
     {
 #if 0
@@ -2148,7 +2495,7 @@ void TY_(ReportNumWarnings)( TidyDocImpl* doc )
                   doc->errors, doc->errors == 1 ? "error" : "errors" );
 
         if ( doc->errors > cfg(doc, TidyShowErrors) ||
-             !cfgBool(doc, TidyShowWarnings) )
+             !cfgBool(doc, TidyShowWarnings) || HiddenRepeats(doc) > 0 )
             tidy_out( doc, " Not all warnings/errors were shown.\n\n" );
         else
             tidy_out( doc, "\n\n" );
@@ -26,6 +26,12 @@
 
 ctmbstr TY_(ReleaseDate)(void);
 
+/* Builds the lookup tables of message formats and option docs */
+void TY_(InitMessages)(void);
+
+/* Restarts the show-repeats counts */
+void TY_(ResetMessageRepeats)( TidyDocImpl* doc );
+
 /* void TY_(ShowVersion)( TidyDocImpl* doc ); */
 void TY_(ReportUnknownOption)( TidyDocImpl* doc, ctmbstr option );
 void TY_(ReportBadArgument)( TidyDocImpl* doc, ctmbstr option );
@@ -45,6 +51,7 @@ void TY_(ErrorSummary)( TidyDocImpl* doc );
 void TY_(ReportEncodingWarning)(TidyDocImpl* doc, uint code, uint encoding);
 void TY_(ReportEncodingError)(TidyDocImpl* doc, uint code, uint c, Bool discarded);
 void TY_(ReportEntityError)( TidyDocImpl* doc, uint code, ctmbstr entity, int c );
+void TY_(ReportLimitExceeded)( TidyDocImpl* doc, TidyOptionId optId );
 void TY_(ReportAttrError)( TidyDocImpl* doc, Node* node, AttVal* av, uint code );
 void TY_(ReportMissingAttr)( TidyDocImpl* doc, Node* node, ctmbstr name );
 
@@ -160,7 +167,9 @@ void TY_(ReportFatal)(TidyDocImpl* doc, Node* element, Node* node, uint code);
 #define BAD_ALIGN_HTML5              90 /* use of align attr removed from HTML5 */
 #define BAD_SUMMARY_HTML5            91 /* use of summary attr removed from HTML5 */
 
-#define PREVIOUS_LOCATION            92 /* last */
+#define PREVIOUS_LOCATION            92
+#define LIMIT_EXCEEDED               93
+#define HIDDEN_REPEATS               94 /* last */
 
 /* character encoding errors */
 
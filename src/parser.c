@@ -82,7 +82,7 @@ Bool TY_(IsNewNode)(Node *node)
 
 void TY_(CoerceNode)(TidyDocImpl* doc, Node *node, TidyTagId tid, Bool obsolete, Bool unexpected)
 {
-    const Dict* tag = TY_(LookupTagDef)(tid);
+    const Dict* tag = TY_(LookupTagDef)( doc, tid );
     Node* tmp = TY_(InferredTag)(doc, tag->id);
 
     if (obsolete)
@@ -744,6 +744,21 @@ static Bool InsertMisc(Node *element, Node *node)
 }
 
 
+/* Counts a parser starting on an element's content, for max-depth */
+static Bool EnterElement( TidyDocImpl* doc )
+{
+    Lexer* lexer = doc->lexer;
+    uint max = cfg( doc, TidyMaxDepth );
+
+    if ( max > 0 && lexer->depth >= max )
+    {
+        TY_(LimitExceeded)( doc, TidyMaxDepth );
+        return no;
+    }
+    lexer->depth++;
+    return yes;
+}
+
 static void ParseTag( TidyDocImpl* doc, Node *node, GetTokenMode mode )
 {
     Lexer* lexer = doc->lexer;
@@ -772,7 +787,10 @@ static void ParseTag( TidyDocImpl* doc, Node *node, GetTokenMode mode )
 
 	lexer->parent = node; /* [i_a]2 added this - not sure why - CHECKME: */
 
+    if ( !EnterElement(doc) )
+        return;
     (*node->tag->parser)( doc, node, mode );
+    lexer->depth--;
 }
 
 /*
@@ -811,7 +829,15 @@ static void MoveToHead( TidyDocImpl* doc, Node *element, Node *node )
         TY_(ReportError)(doc, element, node, TAG_NOT_ALLOWED_IN );
 
         head = TY_(FindHEAD)(doc);
-        assert(head != NULL);
+        if ( head == NULL )
+        {
+            /* no head when parsing a fragment, drop the element
+               together with its content */
+            if ( node->tag->parser )
+                ParseTag( doc, node, IgnoreWhitespace );
+            TY_(FreeNode)( doc, node );
+            return;
+        }
 
         TY_(InsertNodeAtEnd)(head, node);
 
@@ -1253,7 +1279,7 @@ void TY_(ParseBlock)( TidyDocImpl* doc, Node *element, GetTokenMode mode)
                         node = element->parent;
                         TidyDocFree(doc, node->element);
                         node->element = TY_(tmbstrdup)(doc->allocator, "th");
-                        node->tag = TY_(LookupTagDef)( TidyTag_TH );
+                        node->tag = TY_(LookupTagDef)( doc, TidyTag_TH );
                         continue;
                     }
                 }
@@ -1824,7 +1850,7 @@ void TY_(ParseInline)( TidyDocImpl* doc, Node *element, GetTokenMode mode )
              )
            )
         {
-            node->tag = TY_(LookupTagDef)( TidyTag_BR );
+            node->tag = TY_(LookupTagDef)( doc, TidyTag_BR );
             TidyDocFree(doc, node->element);
             node->element = TY_(tmbstrdup)(doc->allocator, "br");
             TrimSpaces(doc, element);
@@ -4651,6 +4677,7 @@ static void AttributeChecks(TidyDocImpl* doc, Node* node)
 void TY_(ParseDocument)(TidyDocImpl* doc)
 {
     Node *node, *html, *doctype = NULL;
+    PhaseTimer timer;
 
     while ((node = TY_(GetToken)(doc, IgnoreWhitespace)) != NULL)
     {
@@ -4758,7 +4785,11 @@ void TY_(ParseDocument)(TidyDocImpl* doc)
 #if SUPPORT_ACCESSIBILITY_CHECKS
     /* do this before any more document fixes */
     if ( cfg( doc, TidyAccessibilityCheckLevel ) > 0 )
+    {
+        TY_(StartPhase)( &timer );
         TY_(AccessibilityChecks)( doc );
+        TY_(EndPhase)( doc, TidyPhase_Access, &timer );
+    }
 #endif /* #if SUPPORT_ACCESSIBILITY_CHECKS */
 
     if (!TY_(FindHTML)(doc))
@@ -4780,7 +4811,9 @@ void TY_(ParseDocument)(TidyDocImpl* doc)
         TY_(InsertNodeAtEnd)(head, TY_(InferredTag)(doc, TidyTag_TITLE));
     }
 
+    TY_(StartPhase)( &timer );
     AttributeChecks(doc, &doc->root);
+    TY_(EndPhase)( doc, TidyPhase_AttrChecks, &timer );
     ReplaceObsoleteElements(doc, &doc->root);
     TY_(DropEmptyElements)(doc, &doc->root);
     CleanSpaces(doc, &doc->root);
@@ -4791,6 +4824,78 @@ void TY_(ParseDocument)(TidyDocImpl* doc)
         EncloseBlockText(doc, &doc->root);
 }
 
+/*
+  Parses the input as the content of an element of the given type,
+  without inferring html, head and body.  The context element only
+  guides the parser; its content ends up directly under the root.
+*/
+void TY_(ParseFragment)(TidyDocImpl* doc, TidyTagId contextId)
+{
+    Node *context = TY_(InferredTag)(doc, contextId);
+    Node *top = context, *node;
+    uint line = 0, column = 0;
+    PhaseTimer timer;
+
+    /* table parts are parsed inside an implied row and table */
+    if ( TY_(nodeHasCM)(top, CM_ROW) )
+    {
+        node = TY_(InferredTag)(doc, TidyTag_TR);
+        TY_(InsertNodeAtEnd)( node, top );
+        top = node;
+    }
+    if ( TY_(nodeHasCM)(top, CM_TABLE) )
+    {
+        node = TY_(InferredTag)(doc, TidyTag_TABLE);
+        TY_(InsertNodeAtEnd)( node, top );
+        top = node;
+    }
+    TY_(InsertNodeAtEnd)( &doc->root, top );
+    doc->lexer->context = context;
+
+    for (;;)
+    {
+        ParseTag( doc, context, IgnoreWhitespace );
+
+        /*
+          The parser returns early on an end tag for the context, or on
+          a token it leaves to an enclosing element.  Drop end tags, and
+          other tokens if they stopped the parser twice; carry on with
+          the rest.
+        */
+        if ((node = TY_(GetToken)(doc, IgnoreWhitespace)) == NULL)
+            break;
+        if (node->type != EndTag &&
+            (node->line != line || node->column != column))
+        {
+            line = node->line;
+            column = node->column;
+            TY_(UngetToken)( doc );
+            continue;
+        }
+        TY_(ReportError)(doc, context, node, DISCARDING_UNEXPECTED);
+        TY_(FreeNode)( doc, node);
+    }
+    doc->lexer->context = NULL;
+
+    while ((node = context->content) != NULL)
+    {
+        TY_(RemoveNode)( node );
+        TY_(InsertNodeBeforeElement)( top, node );
+    }
+    TY_(RemoveNode)( top );
+    TY_(FreeNode)( doc, top );
+
+    TY_(StartPhase)( &timer );
+    AttributeChecks(doc, &doc->root);
+    TY_(EndPhase)( doc, TidyPhase_AttrChecks, &timer );
+    ReplaceObsoleteElements(doc, &doc->root);
+    TY_(DropEmptyElements)(doc, &doc->root);
+    CleanSpaces(doc, &doc->root);
+
+    if (cfgBool(doc, TidyEncloseBlockText))
+        EncloseBlockText(doc, &doc->root);
+}
+
 Bool TY_(XMLPreserveWhiteSpace)( TidyDocImpl* doc, Node *element)
 {
     AttVal *attribute;
@@ -4861,8 +4966,11 @@ static void ParseXMLElement(TidyDocImpl* doc, Node *element, GetTokenMode mode)
         }
 
         /* parse content on seeing start tag */
-        if (node->type == StartTag)
+        if (node->type == StartTag && EnterElement(doc))
+        {
             ParseXMLElement( doc, node, mode );
+            lexer->depth--;
+        }
 
         TY_(InsertNodeAtEnd)(element, node);
     }
@@ -58,6 +58,11 @@ Bool TY_(IsJavaScript)(Node *node);
 */
 void TY_(ParseDocument)( TidyDocImpl* doc );
 
+/*
+  Content of an element of the given type, no html/head/body
+*/
+void TY_(ParseFragment)( TidyDocImpl* doc, TidyTagId contextId );
+
 
 
 /*
@@ -16,6 +16,10 @@
 #include "entities.h"
 #include "tmbstr.h"
 #include "utf8.h"
+#include "streamio.h"
+#if SUPPORT_THREADS
+#include <pthread.h>
+#endif
 
 /*
   Block-level and unknown elements are printed on
@@ -35,6 +39,10 @@ static int  TextEndsWithNewline( Lexer *lexer, Node *node, uint mode );
 static int  TextStartsWithWhitespace( Lexer *lexer, Node *node, uint start, uint mode );
 static Bool InsideHead( TidyDocImpl* doc, Node *node );
 static Bool ShouldIndent( TidyDocImpl* doc, Node *node );
+static void PPrintContent( TidyDocImpl* doc, uint mode, uint indent,
+                           Node* first, Node* stop );
+static Bool PPrintContentInParallel( TidyDocImpl* doc, uint mode,
+                                     uint indent, Node* element );
 
 /*\
  * Issue #228 20150715 - macros to access --vertical-space tri state configuration parameter
@@ -47,15 +55,7 @@ static Bool ShouldIndent( TidyDocImpl* doc, Node *node );
  * GH: https://github.com/htacg/tidy-html5/issues/108 - Keep indent with tabs #108
  * SF: https://sourceforge.net/p/tidy/feature-requests/3/ - #3 tabs in place of spaces
 \*/
-static uint indent_char = ' ';
-void TY_(PPrintTabs)(void)
-{
-    indent_char = '\t';
-}
-void TY_(PPrintSpaces)(void)
-{
-    indent_char = ' ';
-}
+#define IndentChar(doc) (cfgBool(doc, TidyPPrintTabs) ? '\t' : ' ')
 
 #if SUPPORT_ASIAN_ENCODINGS
 /* #431953 - start RJ Wraplen adjusted for smooth international ride */
@@ -604,7 +604,7 @@ static void WrapLine( TidyDocImpl* doc )
     {
         uint spaces = GetSpaces( pprint );
         for ( i = 0; i < spaces; ++i )
-            TY_(WriteChar)( indent_char, doc->docOut ); /* 20150515 - Issue #108 */
+            TY_(WriteChar)( IndentChar(doc), doc->docOut ); /* 20150515 - Issue #108 */
     }
 
     for ( i = 0; i < pprint->wraphere; ++i )
@@ -656,7 +656,7 @@ static void WrapAttrVal( TidyDocImpl* doc )
     {
         uint spaces = GetSpaces( pprint );
         for ( i = 0; i < spaces; ++i )
-            TY_(WriteChar)( indent_char, doc->docOut ); /* 20150515 - Issue #108 */
+            TY_(WriteChar)( IndentChar(doc), doc->docOut ); /* 20150515 - Issue #108 */
     }
 
     for ( i = 0; i < pprint->wraphere; ++i )
@@ -684,7 +684,7 @@ static void PFlushLineImpl( TidyDocImpl* doc )
     {
         uint spaces = GetSpaces( pprint );
         for ( i = 0; i < spaces; ++i )
-            TY_(WriteChar)( indent_char, doc->docOut ); /* 20150515 - Issue #108 */
+            TY_(WriteChar)( IndentChar(doc), doc->docOut ); /* 20150515 - Issue #108 */
     }
 
     for ( i = 0; i < pprint->linelen; ++i )
@@ -1057,11 +1057,43 @@ static void PPrintString( TidyDocImpl* doc, uint indent, ctmbstr str )
 #endif /* 0 */
 
 
+/* Minified output: may value go without quotes? Otherwise returns
+** the quote mark that occurs less often in it (and needs escaping).
+*/
+static Bool IsUnquotedAttrValue( ctmbstr value, uint* delim )
+{
+    uint dquotes = 0, squotes = 0;
+    Bool bare = ( value != NULL && *value != '\0' );
+
+    for ( ; value && *value; ++value )
+    {
+        switch ( *value )
+        {
+        case '"':
+            ++dquotes;
+            bare = no;
+            break;
+        case '\'':
+            ++squotes;
+            bare = no;
+            break;
+        case ' ': case '\t': case '\n': case '\r': case '\f':
+        case '=': case '<': case '>': case '`':
+            bare = no;
+            break;
+        }
+    }
+
+    *delim = ( squotes < dquotes ? '\'' : '"' );
+    return bare;
+}
+
 static void PPrintAttrValue( TidyDocImpl* doc, uint indent,
                              ctmbstr value, uint delim, Bool wrappable, Bool scriptAttr )
 {
     TidyPrintImpl* pprint = &doc->pprint;
     Bool scriptlets = cfgBool(doc, TidyWrapScriptlets);
+    Bool quoted = yes;
 
     uint mode = PREFORMATTED | ATTRIBVALUE;
     if ( wrappable )
@@ -1075,6 +1107,10 @@ static void PPrintAttrValue( TidyDocImpl* doc, uint indent,
             mode |= CDATA;
     }
 
+    if ( cfgBool(doc, TidyMinify) && !cfgBool(doc, TidyXmlOut) &&
+         !(mode & CDATA) )
+        quoted = !IsUnquotedAttrValue( value, &delim );
+
     if ( delim == 0 )
         delim = '"';
 
@@ -1091,7 +1127,8 @@ static void PPrintAttrValue( TidyDocImpl* doc, uint indent,
         */
     }
 
-    AddChar( pprint, delim );
+    if ( quoted )
+        AddChar( pprint, delim );
 
     if ( value )
     {
@@ -1162,7 +1199,8 @@ static void PPrintAttrValue( TidyDocImpl* doc, uint indent,
         ClearInAttrVal( pprint );
         ClearInString( pprint );
     }
-    AddChar( pprint, delim );
+    if ( quoted )
+        AddChar( pprint, delim );
 }
 
 static uint AttrIndent( TidyDocImpl* doc, Node* node, AttVal* ARG_UNUSED(attr) )
@@ -1200,6 +1238,7 @@ static void PPrintAttribute( TidyDocImpl* doc, uint indent,
     Bool wrapAttrs = cfgBool( doc, TidyWrapAttVals );
     Bool ucAttrs   = cfgBool( doc, TidyUpperCaseAttrs );
     Bool indAttrs  = cfgBool( doc, TidyIndentAttributes );
+    Bool minify    = cfgBool( doc, TidyMinify ) && !xmlOut;
     uint xtra      = AttrIndent( doc, node, attr );
     Bool first     = AttrNoIndentFirst( /*doc,*/ node, attr );
     tmbstr name    = attr->attribute;
@@ -1274,12 +1313,18 @@ static void PPrintAttribute( TidyDocImpl* doc, uint indent,
             PPrintAttrValue( doc, indent, isB ? attr->attribute : NULLSTR,
                              attr->delim, no, scriptAttr );
 
-        else if ( !isB && !TY_(IsNewNode)(node) )
+        else if ( !isB && !TY_(IsNewNode)(node) && !minify )
             PPrintAttrValue( doc, indent, "", attr->delim, yes, scriptAttr );
 
         else 
             SetWrap( doc, indent );
     }
+    /* an empty value, or a boolean one repeating the name, is implied */
+    else if ( minify &&
+              ( attr->value[0] == '\0' ||
+                ( TY_(IsBoolAttribute)(attr) &&
+                  TY_(tmbstrcasecmp)(attr->value, attr->attribute) == 0 ) ) )
+        SetWrap( doc, indent );
     else
         PPrintAttrValue( doc, indent, attr->value, attr->delim, wrappable, no );
 }
@@ -1618,7 +1663,11 @@ static void PPrintDocType( TidyDocImpl* doc, uint indent, Node *node )
         AddChar(pprint, fpi->delim);
     }
 
-    if (fpi && fpi->value && sys && sys->value)
+    if (fpi && fpi->value && sys && sys->value && cfgBool(doc, TidyMinify))
+    {
+        AddChar(pprint, ' ');
+    }
+    else if (fpi && fpi->value && sys && sys->value)
     {
         uint i = pprint->linelen - (TY_(tmbstrlen)(sys->value) + 2) - 1;
         if (!(i>0&&TY_(tmbstrlen)(sys->value)+2+i<wraplen&&i<=(spaces?spaces:2)*2))
@@ -2113,13 +2162,365 @@ static void PPrintMathML( TidyDocImpl* doc, uint indent, Node *node )
     PPrintEndTag( doc, mode, indent, node );
 }
 
+/* Prints the siblings from first up to, but not including, stop */
+static void PPrintContent( TidyDocImpl* doc, uint mode, uint indent,
+                           Node* first, Node* stop )
+{
+    Bool indcont = ( cfgAutoBool(doc, TidyIndentContent) != TidyNoState );
+    Node *content, *last = ( first ? first->prev : NULL );
+
+    for ( content = first; content != stop; content = content->next )
+    {
+        /* kludge for naked text before block level tag */
+        if ( last && !indcont && TY_(nodeIsText)(last) &&
+             content->tag && !TY_(nodeHasCM)(content, CM_INLINE) )
+        {
+            /* TY_(PFlushLine)(fout, indent); */
+            TY_(PFlushLineSmart)( doc, indent );
+        }
+
+        TY_(PPrintTree)( doc, mode, indent, content );
+        last = content;
+    }
+}
+
+/*
+  Parallel printing of the content of <body> (print-threads option).
+
+  The top-level children are split into runs that each start with
+  a block-level container.  Every run but the first is printed by a
+  worker thread into its own buffer, using a private copy of the
+  document (own TidyPrintImpl, own option values, as WrapOff() and
+  friends modify those) and starting from a fresh line at the body
+  content indent.  The calling thread prints the first run as usual,
+  then writes out the buffers in document order.  Should the line
+  state actually reached at the start of a run differ from the fresh
+  line the worker assumed, that run is printed again sequentially,
+  so the output never differs from a single-threaded run.
+*/
+#if SUPPORT_THREADS
+
+typedef struct _PrintRun
+{
+    Node*        first;     /* first node of the run */
+    Node*        stop;      /* node following the run, or NULL */
+    uint         mode;
+    uint         indent;
+    TidyDocImpl* sub;       /* private copy of the document */
+    TidyBuffer   out;       /* encoded output of the run */
+    pthread_t    thread;
+    Bool         started;
+} PrintRun;
+
+enum { MaxPrintRuns = 64 };
+
+static uint CountNodes( Node* node )
+{
+    uint count = 1;
+    for ( node = node->content; node; node = node->next )
+        count += CountNodes( node );
+    return count;
+}
+
+/* Does node start on a fresh line, whatever precedes it? */
+static Bool CanStartRun( Node* node )
+{
+    if ( node->type != StartTag || node->tag == NULL )
+        return no;
+
+    if ( nodeIsMATHML(node) || TY_(nodeCMIsEmpty)(node) ||
+         TY_(nodeCMIsInline)(node) )
+        return no;
+
+    if ( node->tag->parser == TY_(ParsePre) || nodeIsTEXTAREA(node) ||
+         nodeIsSTYLE(node) || nodeIsSCRIPT(node) )
+        return no;
+
+    /* avoid the naked text kludge in PPrintContent() */
+    return ( node->prev == NULL || !TY_(nodeIsText)(node->prev) );
+}
+
+static void InitRunState( TidyPrintImpl* pprint, uint indent )
+{
+    pprint->linelen = pprint->wraphere = pprint->ixInd = 0;
+    InitIndent( &pprint->indent[0] );
+    InitIndent( &pprint->indent[1] );
+    pprint->indent[0].spaces = indent;
+}
+
+static Bool IsRunState( TidyPrintImpl* pprint, uint indent )
+{
+    TidyPrintImpl fresh;
+    InitRunState( &fresh, indent );
+    return ( pprint->linelen == 0 && pprint->wraphere == 0 &&
+             pprint->ixInd == 0 &&
+             memcmp( pprint->indent, fresh.indent, sizeof(fresh.indent) ) == 0 );
+}
+
+static void* PrintRunThread( void* arg )
+{
+    PrintRun* run = (PrintRun*) arg;
+    PPrintContent( run->sub, run->mode, run->indent, run->first, run->stop );
+    return NULL;
+}
+
+static void StartRun( TidyDocImpl* doc, PrintRun* run )
+{
+    TidyDocImpl* sub = (TidyDocImpl*) TidyDocAlloc( doc, sizeof(TidyDocImpl) );
+
+    memcpy( sub, doc, sizeof(TidyDocImpl) );
+    /* own counts, the shared ones are not thread safe */
+    TY_(InitCountingAllocator)( &sub->counter, doc->counter.inner );
+    sub->allocator = &sub->counter.base;
+    TY_(InitPrintBuf)( sub );
+    InitRunState( &sub->pprint, run->indent );
+    sub->progressCallback = NULL;
+    sub->cancelCallback = NULL;
+    /* the copy shares the snapshot strings, it must not resolve it */
+    sub->config.snapshotPending = no;
+
+    /* the worker grows its output, so it must count that as well */
+    tidyBufInitWithAllocator( &run->out, sub->allocator );
+    sub->docOut = TY_(BufferOutput)( sub, &run->out, doc->docOut->encoding,
+                                     doc->docOut->nl );
+    run->sub = sub;
+    run->started = ( pthread_create(&run->thread, NULL,
+                                    PrintRunThread, run) == 0 );
+}
+
+/* Joins the worker and writes its output if it fits where we are */
+static void FinishRun( TidyDocImpl* doc, PrintRun* run )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    TidyPrintImpl* subpp = &run->sub->pprint;
+
+    if ( run->started )
+        pthread_join( run->thread, NULL );
+
+    /* what a block container prints first; harmless to do twice */
+    if ( !TidyClassicVS )
+        PCondFlushLineSmart( doc, run->indent );
+
+    if ( run->started && IsRunState(pprint, run->indent) )
+    {
+        TY_(WriteBytes)( run->out.bp, run->out.size, doc->docOut );
+
+        /* carry on with the line the worker left unfinished */
+        if ( subpp->linelen >= pprint->lbufsize )
+            expand( pprint, subpp->linelen );
+        memcpy( pprint->linebuf, subpp->linebuf, subpp->linelen * sizeof(uint) );
+        pprint->linelen  = subpp->linelen;
+        pprint->wraphere = subpp->wraphere;
+        pprint->ixInd    = subpp->ixInd;
+        pprint->indent[0] = subpp->indent[0];
+        pprint->indent[1] = subpp->indent[1];
+        pprint->line    += subpp->line;
+    }
+    else
+        PPrintContent( doc, run->mode, run->indent, run->first, run->stop );
+
+    doc->counter.count += run->sub->counter.count;
+    doc->counter.bytes += run->sub->counter.bytes;
+    tidyBufFree( &run->out );
+    TY_(FreeAttrHashCopy)( doc, &run->sub->attribs );
+    TY_(ReleaseStreamOut)( run->sub, run->sub->docOut );
+    TidyDocFree( doc, subpp->linebuf );
+    TidyDocFree( doc, run->sub );
+}
+
+static Bool PPrintContentInParallel( TidyDocImpl* doc, uint mode,
+                                     uint indent, Node* element )
+{
+    uint threads = cfg( doc, TidyPrintThreads );
+    uint i, nruns = 0, total = 0, done = 0;
+    PrintRun* runs;
+    Node* node;
+
+    if ( threads < 2 || doc->progressCallback != NULL ||
+         cfgBool(doc, TidyXmlOut) || doc->docOut->encoding == ISO2022 )
+        return no;
+
+    for ( node = element->content; node; node = node->next )
+        total += CountNodes( node );
+
+    if ( threads > MaxPrintRuns )
+        threads = MaxPrintRuns;
+
+    /* cut runs of roughly equal node counts */
+    runs = (PrintRun*) TidyDocAlloc( doc, threads * sizeof(PrintRun) );
+    TidyClearMemory( runs, threads * sizeof(PrintRun) );
+    for ( node = element->content; node; node = node->next )
+    {
+        if ( nruns == 0 ||
+             ( nruns < threads && done * threads >= total * nruns &&
+               CanStartRun(node) ) )
+        {
+            if ( nruns > 0 )
+                runs[ nruns-1 ].stop = node;
+            runs[ nruns ].first  = node;
+            runs[ nruns ].mode   = mode;
+            runs[ nruns ].indent = indent;
+            ++nruns;
+        }
+        done += CountNodes( node );
+    }
+
+    if ( nruns < 2 )
+    {
+        TidyDocFree( doc, runs );
+        return no;
+    }
+
+    for ( i = 1; i < nruns; ++i )
+        StartRun( doc, &runs[i] );
+
+    PPrintContent( doc, mode, indent, runs[0].first, runs[0].stop );
+
+    for ( i = 1; i < nruns; ++i )
+        FinishRun( doc, &runs[i] );
+
+    TidyDocFree( doc, runs );
+    return yes;
+}
+
+#else /* SUPPORT_THREADS */
+
+static Bool PPrintContentInParallel( TidyDocImpl* ARG_UNUSED(doc),
+                                     uint ARG_UNUSED(mode),
+                                     uint ARG_UNUSED(indent),
+                                     Node* ARG_UNUSED(element) )
+{
+    return no;
+}
+
+#endif /* SUPPORT_THREADS */
+
+/* Is node one of the count tag ids in ids? */
+static Bool TagIsOneOf( Node* node, const TidyTagId* ids, uint count )
+{
+    uint i;
+    for ( i = 0; i < count; ++i )
+    {
+        if ( TagIsId(node, ids[i]) )
+            return yes;
+    }
+    return no;
+}
+
+/* Comments and white space right after an omitted tag would move */
+static Bool IsSpaceOrComment( TidyDocImpl* doc, Node* node )
+{
+    if ( node == NULL )
+        return no;
+    if ( node->type == CommentTag )
+        return yes;
+    return ( TY_(nodeIsText)(node) && node->end > node->start &&
+             TY_(IsWhite)(doc->lexer->lexbuf[node->start]) );
+}
+
+/*
+  The start and end tags minify may leave out: those the HTML5 rules
+  for optional tags allow, so that parsing the output builds the same
+  tree.  A p followed by a table keeps its end tag, as a table does
+  not close it in quirks mode.
+*/
+static Bool MinifyOmitsStartTag( TidyDocImpl* doc, Node* node )
+{
+    static const TidyTagId bodyKeeps[] = {
+        TidyTag_META, TidyTag_LINK, TidyTag_SCRIPT, TidyTag_STYLE,
+        TidyTag_TEMPLATE
+    };
+    Node* first = node->content;
+
+    if ( node->attributes != NULL )
+        return no;
+
+    switch ( node->tag->id )
+    {
+    case TidyTag_HTML:
+        return ( first == NULL || first->type != CommentTag );
+    case TidyTag_HEAD:
+        return ( first == NULL || TY_(nodeIsElement)(first) );
+    case TidyTag_BODY:
+        return ( first == NULL ||
+                 (!IsSpaceOrComment(doc, first) &&
+                  !TagIsOneOf(first, bodyKeeps, sizeof(bodyKeeps)/sizeof(bodyKeeps[0]))) );
+    default:
+        return no;
+    }
+}
+
+static Bool MinifyOmitsEndTag( TidyDocImpl* doc, Node* node )
+{
+    static const TidyTagId pClosers[] = {
+        TidyTag_ADDRESS, TidyTag_ARTICLE, TidyTag_ASIDE, TidyTag_BLOCKQUOTE,
+        TidyTag_DETAILS, TidyTag_DIV, TidyTag_DL, TidyTag_FIELDSET,
+        TidyTag_FIGCAPTION, TidyTag_FIGURE, TidyTag_FOOTER, TidyTag_FORM,
+        TidyTag_H1, TidyTag_H2, TidyTag_H3, TidyTag_H4, TidyTag_H5,
+        TidyTag_H6, TidyTag_HEADER, TidyTag_HGROUP, TidyTag_HR,
+        TidyTag_MAIN, TidyTag_MENU, TidyTag_NAV, TidyTag_OL, TidyTag_P,
+        TidyTag_PRE, TidyTag_SECTION, TidyTag_UL
+    };
+    static const TidyTagId pKeepers[] = {
+        TidyTag_A, TidyTag_AUDIO, TidyTag_DEL, TidyTag_INS, TidyTag_MAP,
+        TidyTag_NOSCRIPT, TidyTag_VIDEO
+    };
+    Node* next = node->next;
+    Node* parent = node->parent;
+
+    switch ( node->tag->id )
+    {
+    case TidyTag_HTML:
+    case TidyTag_BODY:
+        return ( next == NULL || next->type != CommentTag );
+    case TidyTag_HEAD:
+    case TidyTag_COLGROUP:
+    case TidyTag_CAPTION:
+        return !IsSpaceOrComment( doc, next );
+    case TidyTag_P:
+        if ( next != NULL )
+            return TagIsOneOf( next, pClosers, sizeof(pClosers)/sizeof(pClosers[0]) );
+        /* unknown parents may be custom elements */
+        return ( parent != NULL && parent->tag != NULL &&
+                 parent->tag->id != TidyTag_UNKNOWN &&
+                 !TagIsOneOf(parent, pKeepers, sizeof(pKeepers)/sizeof(pKeepers[0])) );
+    case TidyTag_LI:
+        return ( next == NULL || nodeIsLI(next) );
+    case TidyTag_DT:
+        return ( nodeIsDT(next) || nodeIsDD(next) );
+    case TidyTag_DD:
+        return ( next == NULL || nodeIsDT(next) || nodeIsDD(next) );
+    case TidyTag_RT:
+    case TidyTag_RP:
+        return ( next == NULL || TagIsId(next, TidyTag_RT) ||
+                 TagIsId(next, TidyTag_RP) );
+    case TidyTag_OPTGROUP:
+        return ( next == NULL || nodeIsOPTGROUP(next) );
+    case TidyTag_OPTION:
+        return ( next == NULL || nodeIsOPTION(next) || nodeIsOPTGROUP(next) );
+    case TidyTag_THEAD:
+        return ( TagIsId(next, TidyTag_TBODY) || TagIsId(next, TidyTag_TFOOT) );
+    case TidyTag_TBODY:
+        return ( next == NULL || TagIsId(next, TidyTag_TBODY) || TagIsId(next, TidyTag_TFOOT) );
+    case TidyTag_TFOOT:
+        return ( next == NULL );
+    case TidyTag_TR:
+        return ( next == NULL || nodeIsTR(next) );
+    case TidyTag_TD:
+    case TidyTag_TH:
+        return ( next == NULL || nodeIsTD(next) || nodeIsTH(next) );
+    default:
+        return no;
+    }
+}
+
 void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
 {
-    Node *content, *last;
+    Node *content;
     uint spaces = cfg( doc, TidyIndentSpaces );
     Bool xhtml = cfgBool( doc, TidyXhtmlOut );
 
-    if ( node == NULL )
+    if ( node == NULL || TidyCancelled(doc) )
         return;
 
     if (doc->progressCallback)
@@ -2285,9 +2686,25 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
             Bool indsmart = ( cfgAutoBool(doc, TidyIndentContent) == TidyAutoState );
             Bool hideend  = cfgBool( doc, TidyHideEndTags ) ||
               cfgBool( doc, TidyOmitOptionalTags );
+            Bool minify   = cfgBool( doc, TidyMinify ) &&
+              !cfgBool( doc, TidyXmlOut );
+            Bool omitst, omitend;
             Bool classic  = TidyClassicVS; /* #228 - cfgBool( doc, TidyVertSpace ); */
             uint contentIndent = indent;
 
+            if ( minify )
+            {
+                omitst  = MinifyOmitsStartTag( doc, node );
+                omitend = MinifyOmitsEndTag( doc, node );
+            }
+            else
+            {
+                /* do not omit elements with attributes */
+                omitst  = hideend && TY_(nodeHasCM)(node, CM_OMITST) &&
+                          node->attributes == NULL;
+                omitend = hideend && TY_(nodeHasCM)(node, CM_OPT);
+            }
+
             /* insert extra newline for classic formatting */
             if (classic && node->parent && node->parent->content != node && !nodeIsHTML(node))
             {
@@ -2307,9 +2724,7 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
             if ( indsmart && node->prev != NULL && classic)
                 TY_(PFlushLineSmart)( doc, indent );
 
-            /* do not omit elements with attributes */
-            if ( !hideend || !TY_(nodeHasCM)(node, CM_OMITST) ||
-                 node->attributes != NULL )
+            if ( !omitst )
             {
                 PPrintTag( doc, mode, indent, node );
 
@@ -2334,20 +2749,9 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
                 contentIndent -= spaces;
             }
 
-            last = NULL;
-            for ( content = node->content; content; content = content->next )
-            {
-                /* kludge for naked text before block level tag */
-                if ( last && !indcont && TY_(nodeIsText)(last) &&
-                     content->tag && !TY_(nodeHasCM)(content, CM_INLINE) )
-                {
-                    /* TY_(PFlushLine)(fout, indent); */
-                    TY_(PFlushLineSmart)( doc, contentIndent );
-                }
-
-                TY_(PPrintTree)( doc, mode, contentIndent, content );
-                last = content;
-            }
+            if ( !nodeIsBODY(node) ||
+                 !PPrintContentInParallel(doc, mode, contentIndent, node) )
+                PPrintContent( doc, mode, contentIndent, node->content, NULL );
 
             /* don't flush line for td and th */
             if ( ShouldIndent(doc, node) ||
@@ -2360,7 +2764,7 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
                )
             {
                 PCondFlushLineSmart( doc, indent );
-                if ( !hideend || !TY_(nodeHasCM)(node, CM_OPT) )
+                if ( !omitend )
                 {
                     PPrintEndTag( doc, mode, indent, node );
                     /* TY_(PFlushLine)( doc, indent ); */
@@ -2368,7 +2772,7 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
             }
             else
             {
-                if ( !hideend || !TY_(nodeHasCM)(node, CM_OPT) )
+                if ( !omitend )
                 {
                     /* newline before endtag for classic formatting */
                     if ( classic && !HasMixedContent(node) )
@@ -2388,7 +2792,7 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
 void TY_(PPrintXMLTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
 {
     Bool xhtmlOut = cfgBool( doc, TidyXhtmlOut );
-    if (node == NULL)
+    if (node == NULL || TidyCancelled(doc))
         return;
 
     if (doc->progressCallback)
@@ -19,6 +19,9 @@
 #include "message.h"
 #include "utf8.h"
 #include "tmbstr.h"
+#if SUPPORT_THREADS
+#include <pthread.h>
+#endif
 
 #ifdef TIDY_WIN32_MLANG_SUPPORT
 #include "win32tc.h"
@@ -73,10 +76,21 @@ static StreamOut stdoutStreamOut =
     { 0, TY_(filesink_putByte) }
 };
 
+static void SetStdErrSink(void)
+{
+  stderrStreamOut.sink.sinkData = stderr;
+}
+
+/* documents created on several threads share this stream */
 StreamOut* TY_(StdErrOutput)(void)
 {
+#if SUPPORT_THREADS
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once( &once, SetStdErrSink );
+#else
   if ( stderrStreamOut.sink.sinkData == 0 )
-      stderrStreamOut.sink.sinkData = stderr;
+      SetStdErrSink();
+#endif
   return &stderrStreamOut;
 }
 
@@ -1076,16 +1090,38 @@ void TIDY_CALL tidyPutByte( TidyOutputSink* sink, uint ch )
     sink->putByte( sink->sinkData, (byte) ch );
 }
 
+/* max-input-size ends the input early */
+static Bool AtByteLimit( StreamIn* in )
+{
+    if ( in->maxBytes > 0 && in->bytesRead >= in->maxBytes )
+    {
+        if ( !tidyIsEOF(&in->source) )
+            TY_(LimitExceeded)( in->doc, TidyMaxInputSize );
+        return yes;
+    }
+    return no;
+}
+
 static uint ReadByte( StreamIn* in )
 {
-    return tidyGetByte( &in->source );
+    uint c;
+
+    if ( AtByteLimit(in) )
+        return EndOfStream;
+    c = tidyGetByte( &in->source );
+    if ( c != EndOfStream )
+        in->bytesRead++;
+    return c;
 }
 Bool TY_(IsEOF)( StreamIn* in )
 {
+    if ( AtByteLimit(in) )
+        return yes;
     return tidyIsEOF( &in->source );
 }
 static void UngetByte( StreamIn* in, uint byteValue )
 {
+    in->bytesRead--;
     tidyUngetByte( &in->source, byteValue );
 }
 static void PutByte( uint byteValue, StreamOut* out )
@@ -1093,6 +1129,16 @@ static void PutByte( uint byteValue, StreamOut* out )
     tidyPutByte( &out->sink, byteValue );
 }
 
+/* Copies already encoded bytes, e.g. output rendered into a
+** buffer with the same encoding, straight through to the sink.
+*/
+void TY_(WriteBytes)( const byte* buf, uint size, StreamOut* out )
+{
+    uint i;
+    for ( i = 0; i < size; ++i )
+        PutByte( buf[i], out );
+}
+
 #if 0
 static void UngetRawBytesToStream( StreamIn *in, byte* buf, int *count )
 {
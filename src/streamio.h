@@ -77,6 +77,9 @@ struct _StreamIn
     int    encoding;
     IOType iotype;
 
+    ulong  bytesRead;
+    ulong  maxBytes;   /* max-input-size while parsing a document */
+
     TidyInputSource source;
 
 #ifdef TIDY_WIN32_MLANG_SUPPORT
@@ -133,6 +136,7 @@ StreamOut* TY_(StdErrOutput)(void);
 void       TY_(ReleaseStreamOut)( TidyDocImpl *doc, StreamOut* out );
 
 void TY_(WriteChar)( uint c, StreamOut* out );
+void TY_(WriteBytes)( const byte* buf, uint size, StreamOut* out );
 void TY_(outBOM)( StreamOut *out );
 
 ctmbstr TY_(GetEncodingNameFromTidyId)(uint id);
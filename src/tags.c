@@ -161,11 +161,11 @@ static CheckAttribs CheckHTML;
 
 /*\ 
  * Issue #167 & #169 & #232
- * Tidy defaults to HTML5 mode
- * but allow this table to be ADJUSTED if NOT HTML5
- * was static const Dict tag_defs[] = 
+ * Tidy defaults to HTML5 mode.  If NOT HTML5, a document
+ * uses its own ADJUSTED copies of a few of these, so the
+ * table is shared by all documents and never changed.
 \*/
-static Dict tag_defs[] =
+static const Dict tag_defs[] =
 {
   { TidyTag_UNKNOWN,    "unknown!",   VERS_UNKNOWN,         NULL,                       (0),                                           NULL,          NULL           },
 
@@ -403,7 +403,21 @@ static void tagsEmptyHash( TidyDocImpl* doc, TidyTagImpl* tags )
 }
 #endif /* ELEMENT_HASH_LOOKUP */
 
-static const Dict* tagsLookup( TidyDocImpl* doc, TidyTagImpl* tags, ctmbstr s )
+/* the document's own definition of np, if it has one */
+static const Dict* tagsHtml4( TidyTagImpl* tags, const Dict* np )
+{
+    uint i;
+
+    if ( tags->html4 && np )
+    {
+        for ( i = 0; i < N_HTML4_TAGS; ++i )
+            if ( tags->html4_tags[i].id == np->id )
+                return &tags->html4_tags[i];
+    }
+    return np;
+}
+
+static const Dict* tagsLookupDef( TidyDocImpl* doc, TidyTagImpl* tags, ctmbstr s )
 {
     const Dict *np;
 #if ELEMENT_HASH_LOOKUP
@@ -445,6 +459,11 @@ static const Dict* tagsLookup( TidyDocImpl* doc, TidyTagImpl* tags, ctmbstr s )
     return NULL;
 }
 
+static const Dict* tagsLookup( TidyDocImpl* doc, TidyTagImpl* tags, ctmbstr s )
+{
+    return tagsHtml4( tags, tagsLookupDef(doc, tags, s) );
+}
+
 static Dict* NewDict( TidyDocImpl* doc, ctmbstr name )
 {
     Dict *np = (Dict*) TidyDocAlloc( doc, sizeof(Dict) );
@@ -562,7 +581,7 @@ Bool TY_(FindTag)( TidyDocImpl* doc, Node *node )
     return no;
 }
 
-const Dict* TY_(LookupTagDef)( TidyTagId tid )
+static const Dict* tagsDefById( TidyTagId tid )
 {
     const Dict *np;
 
@@ -573,6 +592,11 @@ const Dict* TY_(LookupTagDef)( TidyTagId tid )
     return NULL;
 }
 
+const Dict* TY_(LookupTagDef)( TidyDocImpl* doc, TidyTagId tid )
+{
+    return tagsHtml4( &doc->tags, tagsDefById(tid) );
+}
+
 Parser* TY_(FindParser)( TidyDocImpl* doc, Node *node )
 {
     const Dict* np = tagsLookup( doc, &doc->tags, node->element );
@@ -660,6 +684,115 @@ ctmbstr        TY_(GetNextDeclaredTag)( TidyDocImpl* ARG_UNUSED(doc),
     return name;
 }
 
+/* Next node after node in document order, or NULL past the last */
+static Node* NextInTree( Node* root, Node* node )
+{
+    if ( node->content )
+        return node->content;
+    for ( ; node && node != root; node = node->parent )
+    {
+        if ( node->next )
+            return node->next;
+    }
+    return NULL;
+}
+
+/* Sorts the elements by tag id with a counting sort, which keeps
+** them in document order within each id.
+*/
+static void BuildTagIndex( TidyDocImpl* doc )
+{
+    TidyTagImpl* tags = &doc->tags;
+    uint* start = (uint*) TidyDocAlloc( doc, (N_TIDY_TAGS + 1) * sizeof(uint) );
+    Node* node;
+    uint ix;
+
+    TidyClearMemory( start, (N_TIDY_TAGS + 1) * sizeof(uint) );
+    for ( node = doc->root.content; node; node = NextInTree(&doc->root, node) )
+    {
+        if ( node->tag )
+            ++start[ node->tag->id + 1 ];
+    }
+    for ( ix = 1; ix <= N_TIDY_TAGS; ++ix )
+        start[ix] += start[ix - 1];
+
+    tags->byId = (Node**) TidyDocAlloc( doc, (start[N_TIDY_TAGS] + 1) * sizeof(Node*) );
+    for ( node = doc->root.content; node; node = NextInTree(&doc->root, node) )
+    {
+        if ( node->tag )
+            tags->byId[ start[node->tag->id]++ ] = node;
+    }
+
+    /* each start has moved on to the next one's */
+    for ( ix = N_TIDY_TAGS; ix > 0; --ix )
+        start[ix] = start[ix - 1];
+    start[0] = 0;
+    tags->byIdStart = start;
+}
+
+Node** TY_(GetNodesByTagId)( TidyDocImpl* doc, TidyTagId tid, uint* count )
+{
+    TidyTagImpl* tags = &doc->tags;
+
+    *count = 0;
+    if ( (uint) tid >= N_TIDY_TAGS )
+        return NULL;
+    if ( !tags->byIdStart )
+        BuildTagIndex( doc );
+    *count = tags->byIdStart[tid + 1] - tags->byIdStart[tid];
+    return tags->byId + tags->byIdStart[tid];
+}
+
+/* The iterator is one past the position in the index, plus the base
+** of that index.  Each index gets a fresh range of iterator values, so
+** that an iterator made before the index was dropped and rebuilt is
+** out of range, rather than walking the new one.
+*/
+TidyIterator TY_(GetNodesByTagIdList)( TidyDocImpl* doc, TidyTagId tid )
+{
+    uint count;
+    Node** nodes = TY_(GetNodesByTagId)( doc, tid, &count );
+    size_t ix = count > 0 ? (size_t)( nodes - doc->tags.byId ) + 1 : 0;
+    return (TidyIterator) ( ix ? doc->tags.byIdBase + ix : (size_t)0 );
+}
+
+Node* TY_(GetNextNodeByTagId)( TidyDocImpl* doc, TidyIterator* iter )
+{
+    TidyTagImpl* tags = &doc->tags;
+    size_t ix = (size_t) *iter;
+    Node* node;
+
+    /* an index dropped since the iterator was made ends the iteration */
+    if ( !tags->byIdStart || ix <= tags->byIdBase ||
+         ix - tags->byIdBase > tags->byIdStart[N_TIDY_TAGS] )
+    {
+        *iter = (TidyIterator) NULL;
+        return NULL;
+    }
+    ix -= tags->byIdBase;
+    node = tags->byId[ ix - 1 ];
+    *iter = (TidyIterator) ( ix < tags->byIdStart[node->tag->id + 1] ?
+                             tags->byIdBase + ix + 1 : (size_t)0 );
+    return node;
+}
+
+void TY_(FreeTagIndex)( TidyDocImpl* doc )
+{
+    TidyTagImpl* tags = &doc->tags;
+
+    if ( tags->byIdStart )
+    {
+        /* move past this index's iterator values, starting over long
+           before they could wrap */
+        size_t used = (size_t) tags->byIdStart[N_TIDY_TAGS] + 1;
+        tags->byIdBase = tags->byIdBase < ((size_t)-1) / 2 ? tags->byIdBase + used : 0;
+        TidyDocFree( doc, tags->byId );
+        TidyDocFree( doc, tags->byIdStart );
+        tags->byId = NULL;
+        tags->byIdStart = NULL;
+    }
+}
+
 void TY_(InitTags)( TidyDocImpl* doc )
 {
     Dict* xml;
@@ -729,86 +862,73 @@ void TY_(FreeDeclaredTags)( TidyDocImpl* doc, UserTagType tagType )
     }
 }
 
+/* point nodes parsed before the doctype to the HTML4 definitions */
+static void UseHtml4Tags( TidyTagImpl* tags, Node* node )
+{
+    for ( ; node; node = node->next )
+    {
+        node->tag = tagsHtml4( tags, node->tag );
+        UseHtml4Tags( tags, node->content );
+    }
+}
+
 /*\
  * Issue #167 & #169
  * Tidy defaults to HTML5 mode
  * If the <!DOCTYPE ...> is found to NOT be HTML5,
  * then adjust tags to HTML4 mode
  *
- * NOTE: For each change added to here, there must 
- * be a RESET added in TY_(ResetTags) below!
+ * The changed definitions are copies private to the
+ * document, so documents on other threads keep theirs.
 \*/
 void TY_(AdjustTags)( TidyDocImpl *doc )
 {
-    Dict *np = (Dict *)TY_(LookupTagDef)( TidyTag_A );
+    static const TidyTagId html4_ids[N_HTML4_TAGS] =
+        { TidyTag_A, TidyTag_CAPTION, TidyTag_OBJECT };
     TidyTagImpl* tags = &doc->tags;
-    if (np) 
-    {
-        np->parser = TY_(ParseInline);
-        np->model  = CM_INLINE;
-#if ELEMENT_HASH_LOOKUP
-        tagsEmptyHash( doc, tags );
-#endif
-    }
+    Lexer* lexer = doc->lexer;
+    Dict *np;
+    uint i;
+
+    for ( i = 0; i < N_HTML4_TAGS; ++i )
+        tags->html4_tags[i] = *tagsDefById( html4_ids[i] );
+    tags->html4 = yes;
+
+    np = &tags->html4_tags[0];  /* TidyTag_A */
+    np->parser = TY_(ParseInline);
+    np->model  = CM_INLINE;
 
 /*\
  * Issue #196
  * TidyTag_CAPTION allows %flow; in HTML5,
  * but only %inline; in HTML4
 \*/
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_CAPTION );
-    if (np)
-    {
-        np->parser = TY_(ParseInline);
-#if ELEMENT_HASH_LOOKUP
-        tagsEmptyHash( doc, tags );
-#endif
-    }
+    np = &tags->html4_tags[1];  /* TidyTag_CAPTION */
+    np->parser = TY_(ParseInline);
 
 /*\
  * Issue #232
  * TidyTag_OBJECT not in head in HTML5,
  * but still allowed in HTML4
 \*/
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_OBJECT );
-    if (np)
+    np = &tags->html4_tags[2];  /* TidyTag_OBJECT */
+    np->model |= CM_HEAD; /* add back allowed in head */
+
+    UseHtml4Tags( tags, &doc->root );
+    if ( lexer )
     {
-        np->model |= CM_HEAD; /* add back allowed in head */
-#if ELEMENT_HASH_LOOKUP
-        tagsEmptyHash( doc, tags );
-#endif
+        for ( i = 0; i < lexer->istacksize; ++i )
+            lexer->istack[i].tag = tagsHtml4( tags, lexer->istack[i].tag );
     }
 }
 
 /*\
  * Issue #285
- * Reset the table to default HTML5 mode.
- * For every change made in the above AdjustTags,
- * the equivalent reset must be added here.
+ * Reset to default HTML5 mode.
 \*/
 void TY_(ResetTags)( TidyDocImpl *doc )
 {
-    Dict *np = (Dict *)TY_(LookupTagDef)( TidyTag_A );
-    TidyTagImpl* tags = &doc->tags;
-    if (np) 
-    {
-        np->parser = TY_(ParseBlock);
-        np->model  = (CM_INLINE|CM_BLOCK|CM_MIXED);
-    }
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_CAPTION );
-    if (np)
-    {
-        np->parser = TY_(ParseBlock);
-    }
-
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_OBJECT );
-    if (np)
-    {
-        np->model = (CM_OBJECT|CM_IMG|CM_INLINE|CM_PARAM); /* reset */
-    }
-#if ELEMENT_HASH_LOOKUP
-    tagsEmptyHash( doc, tags ); /* not sure this is really required, but to be sure */
-#endif
+    doc->tags.html4 = no;
 }
 
 void TY_(FreeTags)( TidyDocImpl* doc )
@@ -820,6 +940,7 @@ void TY_(FreeTags)( TidyDocImpl* doc )
 #endif
     TY_(FreeDeclaredTags)( doc, tagtype_null );
     FreeDict( doc, tags->xml_tags );
+    TY_(FreeTagIndex)( doc );
 
     /* get rid of dangling tag references */
     TidyClearMemory( tags, sizeof(TidyTagImpl) );
@@ -1101,6 +1222,34 @@ NodeTraversalSignal TY_(TraverseNodeTree)(TidyDocImpl* doc, Node* node, NodeTrav
     return ContinueTraversal;
 }
 
+/* run several passes over the node, its siblings and their children */
+void TY_(RunTreePasses)(TidyDocImpl* doc, Node* node, const TreePass* passes, uint count)
+{
+    uint i;
+
+    while (node)
+    {
+        if ( TidyCancelled(doc) )
+            return;
+
+        for (i = 0; i < count; ++i)
+        {
+            if (passes[i].pre)
+                (*passes[i].pre)(doc, node, passes[i].propagate);
+        }
+
+        if (node->content)
+            TY_(RunTreePasses)(doc, node->content, passes, count);
+
+        for (i = 0; i < count; ++i)
+        {
+            if (passes[i].post)
+                (*passes[i].post)(doc, node, passes[i].propagate);
+        }
+        node = node->next;
+    }
+}
+
 
 
 /*
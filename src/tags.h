@@ -62,6 +62,9 @@ struct _DictHash
 typedef struct _DictHash DictHash;
 #endif
 
+/* Elements defined differently by HTML4, see TY_(AdjustTags)() */
+enum { N_HTML4_TAGS = 3 };
+
 struct _TidyTagImpl
 {
     Dict* xml_tags;                /* placeholder for all xml tags */
@@ -69,12 +72,18 @@ struct _TidyTagImpl
 #if ELEMENT_HASH_LOOKUP
     DictHash* hashtab[ELEMENT_HASH_SIZE];
 #endif
+    Dict html4_tags[N_HTML4_TAGS]; /* used instead of the shared HTML5 */
+    Bool html4;                    /* definitions if html4 is set */
+
+    Node** byId;                   /* elements by tag id, built on demand */
+    uint*  byIdStart;              /* where each tag id starts in byId */
+    size_t byIdBase;               /* iterator offset, moved on per index */
 };
 
 typedef struct _TidyTagImpl TidyTagImpl;
 
 /* interface for finding tag by name */
-const Dict* TY_(LookupTagDef)( TidyTagId tid );
+const Dict* TY_(LookupTagDef)( TidyDocImpl* doc, TidyTagId tid );
 Bool    TY_(FindTag)( TidyDocImpl* doc, Node *node );
 Parser* TY_(FindParser)( TidyDocImpl* doc, Node *node );
 void    TY_(DefineTag)( TidyDocImpl* doc, UserTagType tagType, ctmbstr name );
@@ -84,6 +93,16 @@ TidyIterator   TY_(GetDeclaredTagList)( TidyDocImpl* doc );
 ctmbstr        TY_(GetNextDeclaredTag)( TidyDocImpl* doc, UserTagType tagType,
                                         TidyIterator* iter );
 
+/* Elements with the given tag id, in document order.  The tree is
+** indexed on first use; the index is valid until FreeTagIndex().
+*/
+Node**         TY_(GetNodesByTagId)( TidyDocImpl* doc, TidyTagId tid, uint* count );
+TidyIterator   TY_(GetNodesByTagIdList)( TidyDocImpl* doc, TidyTagId tid );
+Node*          TY_(GetNextNodeByTagId)( TidyDocImpl* doc, TidyIterator* iter );
+
+/* Drops the index, to be called whenever the tree changes */
+void TY_(FreeTagIndex)( TidyDocImpl* doc );
+
 void TY_(InitTags)( TidyDocImpl* doc );
 void TY_(FreeTags)( TidyDocImpl* doc );
 void TY_(AdjustTags)( TidyDocImpl *doc ); /* if NOT HTML5 DOCTYPE, fall back to HTML4 legacy mode */
@@ -58,8 +58,23 @@ struct _TidyDocImpl
     StreamOut*          errout;
     TidyReportFilter    mssgFilt;
     TidyReportFilter2   mssgFilt2;
+    TidyReportRecordFilter mssgRecFilt;
+    TidyMessageRecord   mssgRec;
+    uint*               mssgRepeats;  /* per message code, for show-repeats */
     TidyOptCallback     pOptCallback;
     TidyPPProgress      progressCallback;
+    TidyCancelCallback  cancelCallback;
+    uint                cancelInterval;
+    uint                cancelCountdown;
+    Bool                cancelled;
+
+    /* Nodes found by FindDocType(), FindHTML(), FindHEAD(), FindTITLE()
+       and FindBody(), checked on use and cleared by FreeNode() */
+    Node*               doctypeNode;
+    Node*               htmlNode;
+    Node*               headNode;
+    Node*               titleNode;
+    Node*               bodyNode;
 
     /* Parse + Repair Results */
     uint                optionErrors;
@@ -76,12 +91,16 @@ struct _TidyDocImpl
     uint                badForm;     /* bit field, for badly placed form tags, or other format errors */
 
     /* Memory allocator */
-    TidyAllocator*      allocator;
+    TidyAllocator*      allocator;   /* &counter, forwarding to the given one */
+    CountingAllocator   counter;
+    TidyStats           stats;       /* phase times for tidyGetStats() */
 
     /* Miscellaneous */
     void*               appData;
     uint                nClassId;
     Bool                inputHadBOM;
+    Bool                isFragment;  /* parsed by tidyParseFragment() */
+    TidyOptionId        limitHit;    /* resource limit that stopped the parse */
 
 #ifdef TIDY_STORE_ORIGINAL_TEXT
     Bool                storeText;
@@ -123,6 +142,25 @@ TidyOption   tidyImplToOption( const TidyOptionImpl* option );
 
 #endif
 
+#ifndef ECANCELED
+#define ECANCELED 125
+#endif
+
+/* Polls the cancel callback; see tidySetCancelCallback() */
+Bool TY_(PollCancel)( TidyDocImpl* doc );
+#define TidyCancelled(doc) ((doc)->cancelCallback != NULL && TY_(PollCancel)(doc))
+
+/* Time spent in a phase, for tidyGetStats() */
+typedef struct _PhaseTimer
+{
+    ulong   sec;
+    ulong   usec;
+    ulong   cpu;
+} PhaseTimer;
+
+void TY_(StartPhase)( PhaseTimer* timer );
+void TY_(EndPhase)( TidyDocImpl* doc, TidyPhase phase, const PhaseTimer* timer );
+
 /** Wrappers for easy memory allocation using the document's allocator */
 #define TidyDocAlloc(doc, size) TidyAlloc((doc)->allocator, size)
 #define TidyDocRealloc(doc, block, size) TidyRealloc((doc)->allocator, block, size)
@@ -153,4 +191,23 @@ typedef NodeTraversalSignal NodeTraversalCallBack(TidyDocImpl* doc, Node* node,
 
 NodeTraversalSignal TY_(TraverseNodeTree)(TidyDocImpl* doc, Node* node, NodeTraversalCallBack *cb, void *propagate);
 
+/*
+   Tree passes: a pass has hooks called for every node before and/or after
+   its children are visited.  RunTreePasses() runs several passes in one
+   traversal, calling each node's hooks in pass order, so only passes that
+   do not need another pass to have finished the whole tree may share it.
+   Hooks may change the node's attributes and content, but must not remove
+   or move the node itself.
+ */
+typedef void TreePassHook(TidyDocImpl* doc, Node* node, void *propagate);
+
+typedef struct _TreePass
+{
+    TreePassHook *pre;       /* before the node's children, or NULL */
+    TreePassHook *post;      /* after the node's children, or NULL */
+    void *propagate;         /* passed to the hooks */
+} TreePass;
+
+void TY_(RunTreePasses)(TidyDocImpl* doc, Node* node, const TreePass* passes, uint count);
+
 #endif /* __TIDY_INT_H__ */
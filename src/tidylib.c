@@ -19,6 +19,12 @@
 */
 
 #include <errno.h>
+#include <time.h>
+#if defined(_WIN32)
+#include <sys/timeb.h>
+#else
+#include <sys/time.h>
+#endif
 
 #include "tidy-int.h"
 #include "parser.h"
@@ -42,6 +48,7 @@
 /* Create/Destroy a Tidy "document" object */
 static TidyDocImpl* tidyDocCreate( TidyAllocator *allocator );
 static void         tidyDocRelease( TidyDocImpl* impl );
+static void         tidyDocClear( TidyDocImpl* impl );
 
 static int          tidyDocStatus( TidyDocImpl* impl );
 
@@ -51,6 +58,17 @@ static int          tidyDocParseStdin( TidyDocImpl* impl );
 static int          tidyDocParseString( TidyDocImpl* impl, ctmbstr content );
 static int          tidyDocParseBuffer( TidyDocImpl* impl, TidyBuffer* inbuf );
 static int          tidyDocParseSource( TidyDocImpl* impl, TidyInputSource* docIn );
+static int          tidyDocParseFragment( TidyDocImpl* impl, ctmbstr content,
+                                          TidyTagId context );
+static int          tidyDocTokenizeString( TidyDocImpl* impl, ctmbstr content,
+                                           TidyTokenCallback callback );
+static int          tidyDocTokenizeBuffer( TidyDocImpl* impl, TidyBuffer* inbuf,
+                                           TidyTokenCallback callback );
+static int          tidyDocTokenizeSource( TidyDocImpl* impl, TidyInputSource* docIn,
+                                           TidyTokenCallback callback );
+static int          DocParseStreamIn( TidyDocImpl* impl, StreamIn* in,
+                                      TidyTagId context,
+                                      TidyTokenCallback callback );
 
 
 /* Execute post-parse diagnostics and cleanup.
@@ -69,6 +87,8 @@ static int          tidyDocSaveStdout( TidyDocImpl* impl );
 static int          tidyDocSaveString( TidyDocImpl* impl, tmbstr buffer, uint* buflen );
 static int          tidyDocSaveBuffer( TidyDocImpl* impl, TidyBuffer* outbuf );
 static int          tidyDocSaveSink( TidyDocImpl* impl, TidyOutputSink* docOut );
+static int          tidyDocSaveAllocated( TidyDocImpl* impl, tmbstr* buffer, uint* buflen );
+static int          tidyDocSaveMeasure( TidyDocImpl* impl, uint* buflen );
 static int          tidyDocSaveStream( TidyDocImpl* impl, StreamOut* out );
 
 #ifdef NEVER
@@ -137,13 +157,35 @@ void TIDY_CALL          tidyRelease( TidyDoc tdoc )
   tidyDocRelease( impl );
 }
 
+void TIDY_CALL          tidyReset( TidyDoc tdoc )
+{
+  TidyDocImpl* doc = tidyDocToImpl( tdoc );
+  if ( doc )
+  {
+    assert( doc->docIn == NULL );
+    assert( doc->docOut == NULL );
+
+    tidyDocClear( doc );
+    TY_(ResetMessageRepeats)( doc );
+
+    doc->optionErrors = doc->errors = doc->warnings = 0;
+    doc->accessErrors = doc->infoMessages = doc->docErrors = 0;
+    doc->parseStatus = 0;
+    doc->badAccess = doc->badLayout = doc->badChars = doc->badForm = 0;
+    doc->nClassId = 0;
+    doc->inputHadBOM = no;
+  }
+}
+
 TidyDocImpl* tidyDocCreate( TidyAllocator *allocator )
 {
     TidyDocImpl* doc = (TidyDocImpl*)TidyAlloc( allocator, sizeof(TidyDocImpl) );
     TidyClearMemory( doc, sizeof(*doc) );
-    doc->allocator = allocator;
+    TY_(InitCountingAllocator)( &doc->counter, allocator );
+    doc->allocator = &doc->counter.base;
 
     TY_(InitMap)();
+    TY_(InitMessages)();
     TY_(InitTags)( doc );
     TY_(InitAttrs)( doc );
     TY_(InitConfig)( doc );
@@ -176,6 +218,8 @@ void          tidyDocRelease( TidyDocImpl* doc )
 
         if (doc->givenDoctype)
             TidyDocFree(doc, doc->givenDoctype);
+        if (doc->mssgRepeats)
+            TidyDocFree(doc, doc->mssgRepeats);
 
         TY_(FreeConfig)( doc );
         TY_(FreeAttrTable)( doc );
@@ -628,6 +672,31 @@ Bool TIDY_CALL tidyOptCopyConfig( TidyDoc to, TidyDoc from )
     return no;
 }
 
+TidyConfigProfile TIDY_CALL tidyCreateConfigProfile( TidyDoc tdoc )
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+        return (TidyConfigProfile) TY_(NewConfigProfile)( impl );
+    return NULL;
+}
+
+Bool TIDY_CALL tidyApplyConfigProfile( TidyDoc tdoc, TidyConfigProfile profile )
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl && profile )
+    {
+        TY_(ApplyConfigProfile)( impl, (const TidyConfigProfileImpl*) profile );
+        return yes;
+    }
+    return no;
+}
+
+void TIDY_CALL tidyReleaseConfigProfile( TidyConfigProfile profile )
+{
+    if ( profile )
+        TY_(FreeConfigProfile)( (TidyConfigProfileImpl*) profile );
+}
+
 
 /* I/O and Message handling interface
 **
@@ -668,6 +737,21 @@ Bool TIDY_CALL        tidySetReportFilter2( TidyDoc tdoc, TidyReportFilter2 filt
   return no;
 }
 
+/* Use TidyReportRecordFilter to get diagnostics as records
+** (code, level, position, element and attribute) without having
+** to parse the message text.
+*/
+Bool TIDY_CALL        tidySetReportRecordFilter( TidyDoc tdoc, TidyReportRecordFilter filt )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  if ( impl )
+  {
+    impl->mssgRecFilt = filt;
+    return yes;
+  }
+  return no;
+}
+
 #if 0   /* Not yet */
 int         tidySetContentOutputSink( TidyDoc tdoc, TidyOutputSink* outp )
 {
@@ -765,6 +849,30 @@ Bool TIDY_CALL        tidySetPrettyPrinterCallback(TidyDoc tdoc, TidyPPProgress
     return no;
 }
 
+Bool TIDY_CALL        tidySetCancelCallback( TidyDoc tdoc, TidyCancelCallback callback,
+                                             uint interval )
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+    {
+        impl->cancelCallback = callback;
+        impl->cancelInterval = interval > 0 ? interval : 1;
+        impl->cancelCountdown = impl->cancelInterval;
+        return yes;
+    }
+    return no;
+}
+
+Bool TY_(PollCancel)( TidyDocImpl* doc )
+{
+    if ( !doc->cancelled && --doc->cancelCountdown == 0 )
+    {
+        doc->cancelCountdown = doc->cancelInterval;
+        doc->cancelled = doc->cancelCallback( tidyImplToDoc(doc) );
+    }
+    return doc->cancelled;
+}
+
 
 /* Document info */
 int TIDY_CALL        tidyStatus( TidyDoc tdoc )
@@ -824,6 +932,69 @@ uint TIDY_CALL       tidyConfigErrorCount( TidyDoc tdoc )
     return count;
 }
 
+static void CountTree( Node* node, uint depth, TidyStats* stats )
+{
+    AttVal* av;
+
+    for ( ; node; node = node->next )
+    {
+        stats->nodes++;
+        if ( depth > stats->maxDepth )
+            stats->maxDepth = depth;
+        for ( av = node->attributes; av; av = av->next )
+            stats->attributes++;
+        CountTree( node->content, depth + 1, stats );
+    }
+}
+
+int TIDY_CALL        tidyGetStats( TidyDoc tdoc, TidyStats* stats )
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( !impl || !stats )
+        return -EINVAL;
+
+    memcpy( stats, &impl->stats, sizeof(TidyStats) );
+    stats->nodes = stats->attributes = stats->maxDepth = 0;
+    CountTree( impl->root.content, 1, stats );
+    stats->lexbufSize = impl->lexer ? impl->lexer->lexlength : 0;
+    stats->printBufSize = impl->pprint.lbufsize * sizeof(uint);
+    stats->allocCount = impl->counter.count;
+    stats->allocBytes = impl->counter.bytes;
+    return 0;
+}
+
+static void WallClock( ulong* sec, ulong* usec )
+{
+#if defined(_WIN32)
+    struct _timeb tb;
+    _ftime( &tb );
+    *sec = (ulong) tb.time;
+    *usec = (ulong) tb.millitm * 1000;
+#else
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    *sec = (ulong) tv.tv_sec;
+    *usec = (ulong) tv.tv_usec;
+#endif
+}
+
+void TY_(StartPhase)( PhaseTimer* timer )
+{
+    WallClock( &timer->sec, &timer->usec );
+    timer->cpu = (ulong) clock();
+}
+
+void TY_(EndPhase)( TidyDocImpl* doc, TidyPhase phase, const PhaseTimer* timer )
+{
+    ulong sec, usec, cpu = (ulong) clock();
+
+    WallClock( &sec, &usec );
+    doc->stats.wallTime[ phase ] +=
+        (unsigned long long) (sec - timer->sec) * 1000000 + usec - timer->usec;
+    doc->stats.cpuTime[ phase ] +=
+        (unsigned long long) ((double) (cpu - timer->cpu) * 1000000.0 / CLOCKS_PER_SEC);
+}
+
 
 /* Error reporting functions
 */
@@ -876,6 +1047,29 @@ int TIDY_CALL  tidyParseSource( TidyDoc tdoc, TidyInputSource* source )
     TidyDocImpl* doc = tidyDocToImpl( tdoc );
     return tidyDocParseSource( doc, source );
 }
+int TIDY_CALL  tidyParseFragment( TidyDoc tdoc, ctmbstr content, TidyTagId context )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    return tidyDocParseFragment( doc, content, context );
+}
+int TIDY_CALL  tidyTokenizeString( TidyDoc tdoc, ctmbstr content,
+                                   TidyTokenCallback callback )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    return tidyDocTokenizeString( doc, content, callback );
+}
+int TIDY_CALL  tidyTokenizeBuffer( TidyDoc tdoc, TidyBuffer* inbuf,
+                                   TidyTokenCallback callback )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    return tidyDocTokenizeBuffer( doc, inbuf, callback );
+}
+int TIDY_CALL  tidyTokenizeSource( TidyDoc tdoc, TidyInputSource* source,
+                                   TidyTokenCallback callback )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    return tidyDocTokenizeSource( doc, source, callback );
+}
 
 
 int   tidyDocParseFile( TidyDocImpl* doc, ctmbstr filnam )
@@ -954,6 +1148,28 @@ int   tidyDocParseString( TidyDocImpl* doc, ctmbstr content )
     return status;
 }
 
+int   tidyDocParseFragment( TidyDocImpl* doc, ctmbstr content, TidyTagId context )
+{
+    int status = -EINVAL;
+    const Dict* dict = TY_(LookupTagDef)( doc, context );
+    TidyBuffer inbuf;
+    StreamIn* in = NULL;
+
+    /* the context must be able to hold content, but not a document */
+    if ( !content || !dict || !dict->parser || (dict->model & CM_EMPTY) ||
+         context == TidyTag_HTML || context == TidyTag_HEAD ||
+         context == TidyTag_FRAMESET )
+        return status;
+
+    tidyBufInitWithAllocator( &inbuf, doc->allocator );
+    tidyBufAttach( &inbuf, (byte*)content, TY_(tmbstrlen)(content)+1 );
+    in = TY_(BufferInput)( doc, &inbuf, cfg( doc, TidyInCharEncoding ));
+    status = DocParseStreamIn( doc, in, context, NULL );
+    tidyBufDetach( &inbuf );
+    TY_(freeStreamIn)(in);
+    return status;
+}
+
 int   tidyDocParseSource( TidyDocImpl* doc, TidyInputSource* source )
 {
     StreamIn* in = TY_(UserInput)( doc, source, cfg( doc, TidyInCharEncoding ));
@@ -962,6 +1178,51 @@ int   tidyDocParseSource( TidyDocImpl* doc, TidyInputSource* source )
     return status;
 }
 
+int   tidyDocTokenizeString( TidyDocImpl* doc, ctmbstr content,
+                             TidyTokenCallback callback )
+{
+    int status = -EINVAL;
+    TidyBuffer inbuf;
+    StreamIn* in = NULL;
+
+    if ( content && callback )
+    {
+        tidyBufInitWithAllocator( &inbuf, doc->allocator );
+        tidyBufAttach( &inbuf, (byte*)content, TY_(tmbstrlen)(content)+1 );
+        in = TY_(BufferInput)( doc, &inbuf, cfg( doc, TidyInCharEncoding ));
+        status = DocParseStreamIn( doc, in, TidyTag_UNKNOWN, callback );
+        tidyBufDetach( &inbuf );
+        TY_(freeStreamIn)(in);
+    }
+    return status;
+}
+
+int   tidyDocTokenizeBuffer( TidyDocImpl* doc, TidyBuffer* inbuf,
+                             TidyTokenCallback callback )
+{
+    int status = -EINVAL;
+    if ( inbuf && callback )
+    {
+        StreamIn* in = TY_(BufferInput)( doc, inbuf, cfg( doc, TidyInCharEncoding ));
+        status = DocParseStreamIn( doc, in, TidyTag_UNKNOWN, callback );
+        TY_(freeStreamIn)(in);
+    }
+    return status;
+}
+
+int   tidyDocTokenizeSource( TidyDocImpl* doc, TidyInputSource* source,
+                             TidyTokenCallback callback )
+{
+    int status = -EINVAL;
+    if ( source && callback )
+    {
+        StreamIn* in = TY_(UserInput)( doc, source, cfg( doc, TidyInCharEncoding ));
+        status = DocParseStreamIn( doc, in, TidyTag_UNKNOWN, callback );
+        TY_(freeStreamIn)(in);
+    }
+    return status;
+}
+
 
 /* Print/save Functions
 **
@@ -991,6 +1252,26 @@ int TIDY_CALL        tidySaveSink( TidyDoc tdoc, TidyOutputSink* sink )
     TidyDocImpl* doc = tidyDocToImpl( tdoc );
     return tidyDocSaveSink( doc, sink );
 }
+int TIDY_CALL        tidySaveAllocated( TidyDoc tdoc, tmbstr* buffer, uint* buflen )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    if ( doc )
+        return tidyDocSaveAllocated( doc, buffer, buflen );
+    return -EINVAL;
+}
+void TIDY_CALL       tidyReleaseSaved( TidyAllocator* allocator, tmbstr buffer )
+{
+    if ( allocator == NULL )
+        allocator = &TY_(g_default_allocator);
+    TidyFree( allocator, buffer );
+}
+int TIDY_CALL        tidySaveMeasure( TidyDoc tdoc, uint* buflen )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    if ( doc )
+        return tidyDocSaveMeasure( doc, buflen );
+    return -EINVAL;
+}
 
 int         tidyDocSaveFile( TidyDocImpl* doc, ctmbstr filnam )
 {
@@ -1131,6 +1412,57 @@ int         tidyDocSaveBuffer( TidyDocImpl* doc, TidyBuffer* outbuf )
     return status;
 }
 
+int         tidyDocSaveAllocated( TidyDocImpl* doc, tmbstr* buffer, uint* buflen )
+{
+    int status = -EINVAL;
+    if ( buffer && buflen )
+    {
+        TidyBuffer outbuf;
+        tidyBufInitWithAllocator( &outbuf, doc->allocator );
+        status = tidyDocSaveBuffer( doc, &outbuf );
+
+        /* TidyBuffer always keeps room for a trailing NUL */
+        if ( status >= 0 && outbuf.bp == NULL )
+            tidyBufCheckAlloc( &outbuf, 0, 0 );
+        if ( status >= 0 && outbuf.bp == NULL )
+            status = -ENOMEM;
+
+        if ( status >= 0 )
+        {
+            outbuf.bp[ outbuf.size ] = '\0';
+            *buffer = (tmbstr) outbuf.bp;
+            *buflen = outbuf.size;
+            tidyBufDetach( &outbuf );
+        }
+        else
+        {
+            *buffer = NULL;
+            *buflen = 0;
+            tidyBufFree( &outbuf );
+        }
+    }
+    return status;
+}
+
+/* Sink that only counts the bytes written to it */
+static void TIDY_CALL countByte( void* sinkData, byte ARG_UNUSED(bv) )
+{
+    ++*(uint*) sinkData;
+}
+
+int         tidyDocSaveMeasure( TidyDocImpl* doc, uint* buflen )
+{
+    int status = -EINVAL;
+    if ( buflen )
+    {
+        TidyOutputSink sink;
+        *buflen = 0;
+        tidyInitSink( &sink, buflen, countByte );
+        status = tidyDocSaveSink( doc, &sink );
+    }
+    return status;
+}
+
 int         tidyDocSaveSink( TidyDocImpl* doc, TidyOutputSink* sink )
 {
     uint outenc = cfg( doc, TidyOutCharEncoding );
@@ -1143,6 +1475,10 @@ int         tidyDocSaveSink( TidyDocImpl* doc, TidyOutputSink* sink )
 
 int         tidyDocStatus( TidyDocImpl* doc )
 {
+    if ( doc->cancelled )
+        return -ECANCELED;
+    if ( doc->limitHit != TidyUnknownOption )
+        return -E2BIG;
     if ( doc->errors > 0 )
         return 2;
     if ( doc->warnings > 0 || doc->accessErrors > 0 )
@@ -1189,17 +1525,11 @@ int TIDY_CALL        tidyReportDoctype( TidyDoc tdoc )
 */
 static ctmbstr integrity = "\nPanic - tree has lost its integrity\n";
 
-int         TY_(DocParseStream)( TidyDocImpl* doc, StreamIn* in )
+/* Drops the document tree and the lexer state, keeping the buffers
+** of the lexer for the next parse.
+*/
+static void tidyDocClear( TidyDocImpl* doc )
 {
-    Bool xmlIn = cfgBool( doc, TidyXmlTags );
-    int bomEnc;
-
-    assert( doc != NULL && in != NULL );
-    assert( doc->docIn == NULL );
-    doc->docIn = in;
-
-    TY_(ResetTags)(doc);    /* reset table to html5 mode */
-    TY_(TakeConfigSnapshot)( doc );    /* Save config state */
     TY_(FreeAnchors)( doc );
 
     TY_(FreeNode)(doc, &doc->root);
@@ -1209,12 +1539,48 @@ int         TY_(DocParseStream)( TidyDocImpl* doc, StreamIn* in )
         TidyDocFree(doc, doc->givenDoctype);
     /*\ 
      *  Issue #186 - Now FreeNode depend on the doctype, so the lexer is needed
-     *  to determine which hash is to be used, so free it last.
+     *  to determine which hash is to be used, so reset it last.
     \*/
-    TY_(FreeLexer)( doc );
+    TY_(ResetLexer)( doc );
+    TY_(FreeTagIndex)( doc );
     doc->givenDoctype = NULL;
+    doc->isFragment = no;
+    doc->limitHit = TidyUnknownOption;
+    doc->cancelled = no;
+
+    TidyClearMemory( &doc->stats, sizeof(TidyStats) );
+    doc->counter.count = doc->counter.bytes = 0;
+}
+
+int         TY_(DocParseStream)( TidyDocImpl* doc, StreamIn* in )
+{
+    return DocParseStreamIn( doc, in, TidyTag_UNKNOWN, NULL );
+}
 
-    doc->lexer = TY_(NewLexer)( doc );
+/* Parses a whole document, or a fragment if a context element is given,
+** or just passes the tokens to the callback if one is given.
+*/
+static int  DocParseStreamIn( TidyDocImpl* doc, StreamIn* in, TidyTagId context,
+                              TidyTokenCallback callback )
+{
+    Bool xmlIn = cfgBool( doc, TidyXmlTags );
+    int bomEnc;
+    PhaseTimer timer;
+    TidyStats* stats = &doc->stats;
+
+    assert( doc != NULL && in != NULL );
+    assert( doc->docIn == NULL );
+    doc->docIn = in;
+
+    TY_(ResetTags)(doc);    /* reset table to html5 mode */
+    TY_(TakeConfigSnapshot)( doc );    /* Save config state */
+    tidyDocClear( doc );
+    TY_(ResetMessageRepeats)( doc );
+    TY_(StartPhase)( &timer );
+    in->maxBytes = cfg( doc, TidyMaxInputSize );
+
+    if ( !doc->lexer )
+        doc->lexer = TY_(NewLexer)( doc );
     /* doc->lexer->root = &doc->root; */
     doc->root.line = doc->lexer->lines;
     doc->root.column = doc->lexer->columns;
@@ -1233,13 +1599,26 @@ int         TY_(DocParseStream)( TidyDocImpl* doc, StreamIn* in )
         TY_(Win32MLangInitInputTranscoder)(in, in->encoding);
 #endif /* TIDY_WIN32_MLANG_SUPPORT */
 
+    if ( callback )
+    {
+        doc->warnings = 0;
+        TY_(Tokenize)( doc, callback );
+    }
     /* Tidy doesn't alter the doctype for generic XML docs */
-    if ( xmlIn )
+    else if ( xmlIn )
     {
         TY_(ParseXMLDocument)( doc );
         if ( !TY_(CheckNodeIntegrity)( &doc->root ) )
             TidyPanic( doc->allocator, integrity );
     }
+    else if ( context != TidyTag_UNKNOWN )
+    {
+        doc->warnings = 0;
+        doc->isFragment = yes;
+        TY_(ParseFragment)( doc, context );
+        if ( !TY_(CheckNodeIntegrity)( &doc->root ) )
+            TidyPanic( doc->allocator, integrity );
+    }
     else
     {
         doc->warnings = 0;
@@ -1252,6 +1631,16 @@ int         TY_(DocParseStream)( TidyDocImpl* doc, StreamIn* in )
     TY_(Win32MLangUninitInputTranscoder)(in);
 #endif /* TIDY_WIN32_MLANG_SUPPORT */
 
+    /* the parse goes on changing the tree after the accessibility checks */
+    TY_(FreeTagIndex)( doc );
+
+    /* the checks run by the parser have their own times */
+    TY_(EndPhase)( doc, TidyPhase_Parse, &timer );
+    stats->wallTime[TidyPhase_Parse] -= MIN( stats->wallTime[TidyPhase_Parse],
+        stats->wallTime[TidyPhase_AttrChecks] + stats->wallTime[TidyPhase_Access] );
+    stats->cpuTime[TidyPhase_Parse] -= MIN( stats->cpuTime[TidyPhase_Parse],
+        stats->cpuTime[TidyPhase_AttrChecks] + stats->cpuTime[TidyPhase_Access] );
+
     doc->docIn = NULL;
     return tidyDocStatus( doc );
 }
@@ -1260,18 +1649,26 @@ int         tidyDocRunDiagnostics( TidyDocImpl* doc )
 {
     Bool quiet = cfgBool( doc, TidyQuiet );
     Bool force = cfgBool( doc, TidyForceOutput );
+    PhaseTimer timer;
+
+    /* nothing to report on a document left unfinished */
+    if ( TidyCancelled(doc) )
+        return tidyDocStatus( doc );
 
+    TY_(StartPhase)( &timer );
     if ( !quiet )
     {
-
-        TY_(ReportMarkupVersion)( doc );
+        /* a fragment has no doctype to report on */
+        if ( !doc->isFragment )
+            TY_(ReportMarkupVersion)( doc );
         TY_(ReportNumWarnings)( doc );
     }
 
     if ( doc->errors > 0 && !force )
         TY_(NeedsAuthorIntervention)( doc );
 
-     return tidyDocStatus( doc );
+    TY_(EndPhase)( doc, TidyPhase_Diagnostics, &timer );
+    return tidyDocStatus( doc );
 }
 
 void         tidyDocReportDoctype( TidyDocImpl* doc )
@@ -1668,42 +2065,56 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
     Bool mergeEmphasis = cfgBool( doc, TidyMergeEmphasis );
     ctmbstr sdef = NULL;
     Node* node;
+    TreePass passes[2];
+    Bool anchorWants[2], langWants[2];
+    PhaseTimer timer;
 
 #if !defined(NDEBUG) && defined(_MSC_VER)
     SPRTF("All nodes BEFORE clean and repair\n");
     dbg_show_all_nodes( doc, &doc->root, 0  );
 #endif
-    if (tidyXmlTags)
+    if (tidyXmlTags || doc->cancelled)
        return tidyDocStatus( doc );
 
+    TY_(FreeTagIndex)( doc );
+    TY_(StartPhase)( &timer );
+
     /* simplifies <b><b> ... </b> ...</b> etc. */
-    if ( mergeEmphasis )
+    if ( mergeEmphasis && !TidyCancelled(doc) )
         TY_(NestedEmphasis)( doc, &doc->root );
 
-    /* cleans up <dir>indented text</dir> etc. */
-    TY_(List2BQ)( doc, &doc->root );
-    TY_(BQ2Div)( doc, &doc->root );
-
-    /* replaces i by em and b by strong */
-    if ( logical )
-        TY_(EmFromI)( doc, &doc->root );
-
-    if ( word2K && TY_(IsWord2000)(doc) )
+    /* cleans up <dir>indented text</dir> etc., and replaces i by em
+       and b by strong in the same traversal */
+    passes[0].pre = NULL;
+    passes[0].post = TY_(List2BQNode);
+    passes[0].propagate = NULL;
+    passes[1].pre = TY_(EmFromINode);
+    passes[1].post = NULL;
+    passes[1].propagate = NULL;
+    TY_(RunTreePasses)( doc, &doc->root, passes, logical ? 2 : 1 );
+
+    /* needs all lists turned into blockquotes first */
+    if ( !TidyCancelled(doc) )
+        TY_(BQ2Div)( doc, &doc->root );
+
+    if ( word2K && !TidyCancelled(doc) && TY_(IsWord2000)(doc) )
     {
         /* prune Word2000's <![if ...]> ... <![endif]> */
         TY_(DropSections)( doc, &doc->root );
 
         /* drop style & class attributes and empty p, span elements */
-        TY_(CleanWord2000)( doc, &doc->root );
-        TY_(DropEmptyElements)(doc, &doc->root);
+        if ( !TidyCancelled(doc) )
+            TY_(CleanWord2000)( doc, &doc->root );
+        if ( !TidyCancelled(doc) )
+            TY_(DropEmptyElements)(doc, &doc->root);
     }
 
     /* replaces presentational markup by style rules */
-    if ( clean || dropFont )
+    if ( (clean || dropFont) && !TidyCancelled(doc) )
         TY_(CleanDocument)( doc );
 
     /* clean up html exported by Google Docs */
-    if ( gdoc )
+    if ( gdoc && !TidyCancelled(doc) )
         TY_(CleanGoogleDocument)( doc );
 
     /*  Move terminating <br /> tags from out of paragraphs  */
@@ -1730,9 +2141,17 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
     sdef = tidyOptGetValue((TidyDoc)doc, TidyDoctype );
     if (!sdef)
         sdef = tidyOptGetCurrPick((TidyDoc) doc, TidyDoctypeMode );
-    if (sdef && (strcmp(sdef,"html5") == 0)) {
+    if (sdef && (strcmp(sdef,"html5") == 0) && !TidyCancelled(doc)) {
         TY_(CheckHTML5)( doc, &doc->root );
     }
+
+    /* the doctype, namespace and generator fixes are all or nothing */
+    if ( TidyCancelled(doc) )
+    {
+        TY_(EndPhase)( doc, TidyPhase_CleanRepair, &timer );
+        return tidyDocStatus( doc );
+    }
+
     if (node)
     {
         AttVal* fpi = TY_(GetAttrByName)(node, "PUBLIC");
@@ -1744,7 +2163,12 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
         }
     }
 
-    if ( doc->root.content )
+    if ( doc->isFragment )
+    {
+        /* no doctype, namespace or generator for a fragment */
+        TY_(FixAnchors)(doc, &doc->root, wantNameAttr, yes);
+    }
+    else if ( doc->root.content )
     {
         /* If we had XHTML input but want HTML output */
         if ( htmlOut && doc->lexer->isvoyager )
@@ -1758,30 +2182,42 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
         if (xhtmlOut && !htmlOut)
         {
             TY_(SetXHTMLDocType)(doc);
-            TY_(FixAnchors)(doc, &doc->root, wantNameAttr, yes);
             TY_(FixXhtmlNamespace)(doc, yes);
-            TY_(FixLanguageInformation)(doc, &doc->root, yes, yes);
+            langWants[0] = yes;
         }
         else
         {
             TY_(FixDocType)(doc);
-            TY_(FixAnchors)(doc, &doc->root, wantNameAttr, yes);
             TY_(FixXhtmlNamespace)(doc, no);
-            TY_(FixLanguageInformation)(doc, &doc->root, no, yes);
+            langWants[0] = no;
         }
 
+        /* anchors and language attributes in one traversal; both
+           depend on the doctype just fixed */
+        anchorWants[0] = wantNameAttr;
+        anchorWants[1] = yes;
+        langWants[1] = yes;
+        passes[0].pre = TY_(FixAnchorsNode);
+        passes[0].post = NULL;
+        passes[0].propagate = anchorWants;
+        passes[1].pre = TY_(FixLanguageNode);
+        passes[1].post = NULL;
+        passes[1].propagate = langWants;
+        TY_(RunTreePasses)( doc, &doc->root, passes, 2 );
+
         if (tidyMark )
             TY_(AddGenerator)(doc);
     }
 
     /* ensure presence of initial <?xml version="1.0"?> */
-    if ( xmlOut && xmlDecl )
+    if ( xmlOut && xmlDecl && !doc->isFragment )
         TY_(FixXmlDecl)( doc );
 
 #if !defined(NDEBUG) && defined(_MSC_VER)
     SPRTF("All nodes AFTER clean and repair\n");
     dbg_show_all_nodes( doc, &doc->root, 0  );
 #endif
+    TY_(EndPhase)( doc, TidyPhase_CleanRepair, &timer );
     return tidyDocStatus( doc );
 }
 
@@ -1790,6 +2226,9 @@ Bool showBodyOnly( TidyDocImpl* doc, TidyTriState bodyOnly )
 {
     Node* node;
 
+    if ( doc->isFragment )
+        return no;  /* there is nothing but body content */
+
     switch( bodyOnly )
     {
     case TidyNoState:
@@ -1822,14 +2261,11 @@ int         tidyDocSaveStream( TidyDocImpl* doc, StreamOut* out )
     Bool asciiChars   = cfgBool(doc, TidyAsciiChars);
     Bool makeBare     = cfgBool(doc, TidyMakeBare);
     Bool escapeCDATA  = cfgBool(doc, TidyEscapeCdata);
-    Bool ppWithTabs   = cfgBool(doc, TidyPPrintTabs);
     TidyAttrSortStrategy sortAttrStrat = cfg(doc, TidySortAttributes);
+    PhaseTimer timer;
 
-    if (ppWithTabs)
-        TY_(PPrintTabs)();
-    else
-        TY_(PPrintSpaces)();
-
+    TY_(FreeTagIndex)( doc );
+    TY_(StartPhase)( &timer );
     if (escapeCDATA)
         TY_(ConvertCDATANodes)(doc, &doc->root);
 
@@ -1855,7 +2291,7 @@ int         tidyDocSaveStream( TidyDocImpl* doc, StreamOut* out )
     if ( sortAttrStrat != TidySortAttrNone )
         TY_(SortAttributes)(&doc->root, sortAttrStrat);
 
-    if ( showMarkup && (doc->errors == 0 || forceOutput) )
+    if ( showMarkup && (doc->errors == 0 || forceOutput) && !doc->cancelled )
     {
 #if SUPPORT_UTF16_ENCODINGS
         /* Output a Byte Order Mark if required */
@@ -1882,6 +2318,7 @@ int         tidyDocSaveStream( TidyDocImpl* doc, StreamOut* out )
         doc->docOut = NULL;
     }
 
+    TY_(EndPhase)( doc, TidyPhase_Print, &timer );
     TY_(ResetConfigToSnapshot)( doc );
     return tidyDocStatus( doc );
 }
@@ -1950,9 +2387,28 @@ TidyNode TIDY_CALL    tidyDiscardElement( TidyDoc tdoc, TidyNode tnod )
   TidyDocImpl* doc = tidyDocToImpl( tdoc );
   Node* nimp = tidyNodeToImpl( tnod );
   Node* next = TY_(DiscardElement)( doc, nimp );
+  TY_(FreeTagIndex)( doc );
   return tidyImplToNode( next );
 }
 
+TidyIterator TIDY_CALL tidyGetNodesByTagId( TidyDoc tdoc, TidyTagId tid )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  TidyIterator iter = 0;
+  if ( impl )
+      iter = TY_(GetNodesByTagIdList)( impl, tid );
+  return iter;
+}
+
+TidyNode TIDY_CALL    tidyGetNextNodeByTagId( TidyDoc tdoc, TidyIterator* pos )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  Node* node = NULL;
+  if ( impl && pos )
+      node = TY_(GetNextNodeByTagId)( impl, pos );
+  return tidyImplToNode( node );
+}
+
 /* siblings */
 TidyNode TIDY_CALL    tidyGetNext( TidyNode tnod )
 {
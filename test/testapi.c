@@ -0,0 +1,645 @@
+/*
+  testapi.c - checks of the TidyLib API that the console driven
+  regression tests cannot reach.  Run by ctest; prints each failed
+  check and exits with 1 if there were any.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "tidy.h"
+#include "tidybuffio.h"
+#include "message.h" /* the internal message codes, for checking records */
+
+static int failures = 0;
+
+#define CHECK(cond) check( (cond), #cond, __FILE__, __LINE__ )
+
+static void check( int ok, const char* what, const char* file, int line )
+{
+    if ( !ok )
+    {
+        fprintf( stderr, "%s:%d: check failed: %s\n", file, line, what );
+        ++failures;
+    }
+}
+
+static const char* text( TidyBuffer* buf )
+{
+    return buf->bp ? (const char*) buf->bp : "";
+}
+
+static Bool contains( TidyBuffer* buf, const char* what )
+{
+    return strstr( text(buf), what ) != NULL;
+}
+
+/* Parses, cleans and saves content as the content of a context
+** element, returning the parse status.  The output and messages are
+** left in out and errs.
+*/
+static int tidyFragment( const char* content, TidyTagId context,
+                         TidyBuffer* out, TidyBuffer* errs )
+{
+    TidyDoc tdoc = tidyCreate();
+    int status;
+
+    tidySetErrorBuffer( tdoc, errs );
+    status = tidyParseFragment( tdoc, content, context );
+    if ( status >= 0 )
+        tidyCleanAndRepair( tdoc );
+    if ( status >= 0 )
+        tidySaveBuffer( tdoc, out );
+    tidyRelease( tdoc );
+    return status;
+}
+
+static void testFragment( void )
+{
+    TidyBuffer out, errs;
+
+    /* head only elements are dropped with their content, and the
+       context element is not reported as unclosed */
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    CHECK( tidyFragment("<title>Dropped</title><p>one<b>two</p>",
+                        TidyTag_DIV, &out, &errs) == 1 );
+    CHECK( contains(&out, "<p>one<b>two</b></p>") );
+    CHECK( !contains(&out, "title") && !contains(&out, "Dropped") );
+    CHECK( !contains(&out, "<div") && !contains(&out, "<body") );
+    CHECK( !contains(&out, "<html") && !contains(&out, "<!DOCTYPE") );
+    CHECK( !contains(&errs, "missing </div>") );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+
+    /* cells are parsed in an implied row and table, neither of
+       which is written out */
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    CHECK( tidyFragment("<td>1<td>2", TidyTag_TR, &out, &errs) == 0 );
+    CHECK( contains(&out, "<td>1</td>\n<td>2</td>") );
+    CHECK( !contains(&out, "<tr") && !contains(&out, "<table") );
+    CHECK( !contains(&errs, "missing </tr>") );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    CHECK( tidyFragment("<tr><td>1", TidyTag_TBODY, &out, &errs) == 0 );
+    CHECK( contains(&out, "<tr>\n<td>1</td>\n</tr>") );
+    CHECK( !contains(&out, "<tbody") && !contains(&out, "<table") );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+
+    /* contexts that cannot hold a fragment */
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    CHECK( tidyFragment("text", TidyTag_BR, &out, &errs) == -EINVAL );
+    CHECK( tidyFragment("text", TidyTag_HEAD, &out, &errs) == -EINVAL );
+    CHECK( tidyFragment("text", TidyTag_UNKNOWN, &out, &errs) == -EINVAL );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+}
+
+static uint polls = 0;
+static uint cancelAt = 0;
+
+/* Counts the polls, cancelling at the cancelAt'th one if set */
+static Bool TIDY_CALL cancelCallback( TidyDoc ARG_UNUSED(tdoc) )
+{
+    return ++polls == cancelAt;
+}
+
+static const char* cancelDoc =
+    "<html><head><title>Cancel</title></head>\n"
+    "<body><p>one</p><p>two <img src=\"a.png\"></p></body></html>\n";
+
+/* Number of polls for a parse and clean of cancelDoc without a cancel */
+static uint countPolls( uint accessLevel )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer errs;
+
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    tidyOptSetInt( tdoc, TidyAccessibilityCheckLevel, accessLevel );
+    tidySetCancelCallback( tdoc, cancelCallback, 1 );
+    polls = cancelAt = 0;
+    CHECK( tidyParseString(tdoc, cancelDoc) >= 0 );
+    CHECK( tidyCleanAndRepair(tdoc) >= 0 );
+    tidyRelease( tdoc );
+    tidyBufFree( &errs );
+    return polls;
+}
+
+static void testCancel( void )
+{
+    TidyDoc tdoc;
+    TidyBuffer out, errs;
+    TidyNode node;
+    uint parsePolls;
+
+    /* a cancel while parsing carries over to every later call */
+    tdoc = tidyCreate();
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    tidySetCancelCallback( tdoc, cancelCallback, 1 );
+    polls = 0;
+    cancelAt = 2;
+    CHECK( tidyParseString(tdoc, cancelDoc) == -ECANCELED );
+    CHECK( tidyCleanAndRepair(tdoc) == -ECANCELED );
+    CHECK( tidyRunDiagnostics(tdoc) == -ECANCELED );
+    CHECK( tidySaveBuffer(tdoc, &out) == -ECANCELED );
+    CHECK( out.size == 0 );
+    CHECK( polls == 2 );
+
+    /* a new parse clears it */
+    tidySetCancelCallback( tdoc, NULL, 0 );
+    CHECK( tidyParseString(tdoc, cancelDoc) >= 0 );
+    CHECK( tidyCleanAndRepair(tdoc) >= 0 );
+    tidyRelease( tdoc );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+
+    /* a cancel while cleaning skips the passes still to come, such as
+       adding the doctype and the generator */
+    tdoc = tidyCreate();
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    tidyOptSetBool( tdoc, TidyMark, yes );
+    tidySetCancelCallback( tdoc, cancelCallback, 1 );
+    polls = cancelAt = 0;
+    CHECK( tidyParseString(tdoc, cancelDoc) >= 0 );
+    parsePolls = polls;
+    cancelAt = parsePolls + 1;
+    CHECK( tidyCleanAndRepair(tdoc) == -ECANCELED );
+    CHECK( polls == cancelAt );
+    node = tidyGetChild( tidyGetRoot(tdoc) );
+    CHECK( node != NULL && tidyNodeGetType(node) != TidyNode_DocType );
+    for ( node = tidyGetChild(tidyGetHead(tdoc)); node; node = tidyGetNext(node) )
+        CHECK( tidyNodeGetId(node) != TidyTag_META );
+    CHECK( tidySaveBuffer(tdoc, &out) == -ECANCELED );
+    CHECK( out.size == 0 );
+    tidyRelease( tdoc );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+
+    /* the accessibility checks poll as well */
+    CHECK( countPolls(3) > countPolls(0) );
+}
+
+static TidyBuffer tokens;
+
+/* Appends one line per token to tokens, stopping at <b> */
+static Bool TIDY_CALL tokenCallback( TidyDoc tdoc, TidyNode tnod )
+{
+    TidyBuffer value;
+    ctmbstr kind = "?";
+
+    switch ( tidyNodeGetType(tnod) )
+    {
+    case TidyNode_Start:    kind = "start";   break;
+    case TidyNode_End:      kind = "end";     break;
+    case TidyNode_StartEnd: kind = "empty";   break;
+    case TidyNode_Text:     kind = "text";    break;
+    case TidyNode_Comment:  kind = "comment"; break;
+    default:                break;
+    }
+    tidyBufAppend( &tokens, (void*) kind, strlen(kind) );
+    tidyBufPutByte( &tokens, ' ' );
+
+    tidyBufInit( &value );
+    if ( tidyNodeGetValue(tdoc, tnod, &value) )
+        tidyBufAppend( &tokens, value.bp, value.size );
+    else
+        tidyBufAppend( &tokens, (void*) tidyNodeGetName(tnod),
+                       strlen(tidyNodeGetName(tnod)) );
+    tidyBufFree( &value );
+    tidyBufPutByte( &tokens, '\n' );
+
+    return tidyNodeGetId(tnod) != TidyTag_B;
+}
+
+static void testTokenize( void )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer errs;
+    Bool same;
+
+    tidyBufInit( &errs );
+    tidyBufInit( &tokens );
+    tidySetErrorBuffer( tdoc, &errs );
+    CHECK( tidyTokenizeString(tdoc,
+        "<p class=x>a &amp; b</p>"
+        "<script>if (a < b && c) { x(\"<p>\"); }</script>"
+        "<pre>  two\n  lines</pre><!-- note -->"
+        "<b>stop</b><i>never</i>", tokenCallback) >= 0 );
+    tidyBufPutByte( &tokens, '\0' );
+
+    /* entities are decoded, script content is one text token, white
+       space in pre is kept, and nothing is read past <b> */
+    same = strcmp(text(&tokens),
+                  "start p\n"
+                  "text a & b\n"
+                  "end p\n"
+                  "start script\n"
+                  "text if (a < b && c) { x(\"<p>\"); }\n"
+                  "end script\n"
+                  "start pre\n"
+                  "text   two\n  lines\n"
+                  "end pre\n"
+                  "comment  note \n"
+                  "start b\n") == 0;
+    CHECK( same );
+    if ( !same )
+        fprintf( stderr, "tokens:\n%s", text(&tokens) );
+
+    /* no tree is built */
+    CHECK( tidyGetChild(tidyGetRoot(tdoc)) == NULL );
+
+    tidyBufFree( &tokens );
+    tidyBufFree( &errs );
+    tidyRelease( tdoc );
+}
+
+/* The text of the first child of node, for telling elements apart */
+static Bool childTextIs( TidyDoc tdoc, TidyNode node, const char* expected )
+{
+    TidyBuffer value;
+    Bool same;
+
+    tidyBufInit( &value );
+    same = node != NULL &&
+           tidyNodeGetValue( tdoc, tidyGetChild(node), &value ) &&
+           value.size == strlen(expected) &&
+           memcmp( value.bp, expected, value.size ) == 0;
+    tidyBufFree( &value );
+    return same;
+}
+
+static void testNodesByTagId( void )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer errs;
+    TidyIterator iter, stale;
+    TidyNode node, div;
+
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    CHECK( tidyParseString(tdoc, "<!DOCTYPE html><title>t</title>"
+                           "<p>1</p><div><p>2</p></div><p>3</p>") >= 0 );
+
+    /* document order, across nesting */
+    iter = tidyGetNodesByTagId( tdoc, TidyTag_P );
+    CHECK( childTextIs(tdoc, tidyGetNextNodeByTagId(tdoc, &iter), "1") );
+    CHECK( childTextIs(tdoc, tidyGetNextNodeByTagId(tdoc, &iter), "2") );
+    CHECK( childTextIs(tdoc, tidyGetNextNodeByTagId(tdoc, &iter), "3") );
+    CHECK( iter == NULL );
+    CHECK( tidyGetNextNodeByTagId(tdoc, &iter) == NULL );
+
+    /* none at all */
+    iter = tidyGetNodesByTagId( tdoc, TidyTag_TABLE );
+    CHECK( tidyGetNextNodeByTagId(tdoc, &iter) == NULL );
+
+    /* discarding an element ends the iterations running, even once
+       the index has been built again */
+    stale = tidyGetNodesByTagId( tdoc, TidyTag_P );
+    CHECK( tidyGetNextNodeByTagId(tdoc, &stale) != NULL );
+    iter = tidyGetNodesByTagId( tdoc, TidyTag_DIV );
+    div = tidyGetNextNodeByTagId( tdoc, &iter );
+    CHECK( div != NULL );
+    tidyDiscardElement( tdoc, div );
+    iter = tidyGetNodesByTagId( tdoc, TidyTag_P );
+    CHECK( tidyGetNextNodeByTagId(tdoc, &stale) == NULL );
+    CHECK( stale == NULL );
+    CHECK( childTextIs(tdoc, tidyGetNextNodeByTagId(tdoc, &iter), "1") );
+    CHECK( childTextIs(tdoc, tidyGetNextNodeByTagId(tdoc, &iter), "3") );
+    CHECK( iter == NULL );
+
+    /* and so does cleaning */
+    stale = tidyGetNodesByTagId( tdoc, TidyTag_P );
+    CHECK( tidyCleanAndRepair(tdoc) >= 0 );
+    iter = tidyGetNodesByTagId( tdoc, TidyTag_P );
+    CHECK( tidyGetNextNodeByTagId(tdoc, &stale) == NULL );
+    node = tidyGetNextNodeByTagId( tdoc, &iter );
+    CHECK( childTextIs(tdoc, node, "1") );
+
+    tidyBufFree( &errs );
+    tidyRelease( tdoc );
+}
+
+/* An allocator that counts its calls and remembers the last block freed */
+typedef struct _TestAllocator
+{
+    TidyAllocator base;
+    uint allocs;
+    uint frees;
+    void* lastFreed;
+} TestAllocator;
+
+static void* TIDY_CALL countAlloc( TidyAllocator* self, size_t nBytes )
+{
+    ++((TestAllocator*) self)->allocs;
+    return malloc( nBytes );
+}
+
+static void* TIDY_CALL countRealloc( TidyAllocator* self, void* block,
+                                     size_t nBytes )
+{
+    ++((TestAllocator*) self)->allocs;
+    return realloc( block, nBytes );
+}
+
+static void TIDY_CALL countFree( TidyAllocator* self, void* block )
+{
+    if ( block )
+    {
+        ++((TestAllocator*) self)->frees;
+        ((TestAllocator*) self)->lastFreed = block;
+    }
+    free( block );
+}
+
+static void TIDY_CALL countPanic( TidyAllocator* ARG_UNUSED(self),
+                                  ctmbstr msg )
+{
+    fprintf( stderr, "panic: %s\n", msg );
+    exit( 2 );
+}
+
+static const TidyAllocatorVtbl countingVtbl =
+{
+    countAlloc, countRealloc, countFree, countPanic
+};
+
+static void testSave( void )
+{
+    TestAllocator counting;
+    TidyDoc tdoc;
+    TidyBuffer out, errs;
+    tmbstr saved = NULL;
+    uint measured = 0, savedLen = 0, frees;
+
+    counting.base.vtbl = &countingVtbl;
+    counting.allocs = counting.frees = 0;
+    counting.lastFreed = NULL;
+
+    tdoc = tidyCreateWithAllocator( &counting.base );
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    CHECK( tidyParseString(tdoc, cancelDoc) >= 0 );
+    CHECK( tidyCleanAndRepair(tdoc) >= 0 );
+
+    /* measuring, saving to a buffer and handing over the output all
+       agree on its length and bytes */
+    CHECK( tidySaveMeasure(tdoc, &measured) >= 0 );
+    CHECK( tidySaveBuffer(tdoc, &out) >= 0 );
+    CHECK( tidySaveAllocated(tdoc, &saved, &savedLen) >= 0 );
+    CHECK( measured > 0 );
+    CHECK( measured == out.size );
+    CHECK( savedLen == measured );
+    CHECK( saved != NULL && saved[savedLen] == '\0' );
+    CHECK( saved != NULL && memcmp(saved, out.bp, out.size) == 0 );
+    tidyRelease( tdoc );
+
+    /* the output outlives the document and goes back through the
+       allocator it came from */
+    frees = counting.frees;
+    tidyReleaseSaved( &counting.base, saved );
+    CHECK( counting.frees == frees + 1 );
+    CHECK( counting.lastFreed == (void*) saved );
+
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+}
+
+static uint filter2Calls = 0;
+
+/* Drops the warnings */
+static Bool TIDY_CALL dropWarnings( TidyDoc ARG_UNUSED(tdoc),
+                                    TidyReportLevel lvl,
+                                    uint ARG_UNUSED(line),
+                                    uint ARG_UNUSED(col),
+                                    ctmbstr ARG_UNUSED(mssg) )
+{
+    return lvl != TidyWarning;
+}
+
+/* Drops the info messages, counting the calls */
+static Bool TIDY_CALL dropInfo( TidyDoc ARG_UNUSED(tdoc),
+                                TidyReportLevel lvl,
+                                uint ARG_UNUSED(line),
+                                uint ARG_UNUSED(col),
+                                ctmbstr ARG_UNUSED(mssg),
+                                va_list ARG_UNUSED(args) )
+{
+    ++filter2Calls;
+    CHECK( lvl != TidyWarning );
+    return lvl != TidyInfo;
+}
+
+static void testReportFilters( void )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer errs;
+
+    /* the second filter only sees what the first one kept, and can
+       drop messages as well */
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    tidySetReportFilter( tdoc, dropWarnings );
+    tidySetReportFilter2( tdoc, dropInfo );
+    CHECK( tidyParseString(tdoc, "<p>one<b>two</p>") >= 0 );
+    CHECK( tidyRunDiagnostics(tdoc) >= 0 );
+    CHECK( filter2Calls > 0 );
+    CHECK( !contains(&errs, "Warning:") );
+    CHECK( !contains(&errs, "Info:") );
+    CHECK( tidyWarningCount(tdoc) > 0 );
+
+    tidyBufFree( &errs );
+    tidyRelease( tdoc );
+}
+
+static TidyMessageRecord repeated;
+static uint records = 0;
+
+/* Keeps the repeated attribute warning, dropping it from the output */
+static Bool TIDY_CALL recordFilter( TidyDoc ARG_UNUSED(tdoc),
+                                    const TidyMessageRecord* rec )
+{
+    ++records;
+    if ( rec->code != REPEATED_ATTRIBUTE )
+        return yes;
+    repeated = *rec;
+    return no;
+}
+
+static void testRecordFilter( void )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer errs;
+
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    tidySetReportRecordFilter( tdoc, recordFilter );
+    memset( &repeated, 0, sizeof(repeated) );
+    CHECK( tidyParseString(tdoc, "<!DOCTYPE html>\n<title>t</title>\n"
+                           "<p>x <img src=a.png width=1 width=2 alt=x>\n") >= 0 );
+    CHECK( tidyRunDiagnostics(tdoc) >= 0 );
+
+    CHECK( repeated.code == REPEATED_ATTRIBUTE );
+    CHECK( repeated.level == TidyWarning );
+    CHECK( repeated.line == 3 && repeated.column == 6 );
+    CHECK( repeated.tagId == TidyTag_IMG );
+    CHECK( repeated.attrId == TidyAttr_WIDTH );
+
+    /* the dropped message is left out of the output but still counted;
+       the others are written as before */
+    CHECK( !contains(&errs, "repeated attribute") );
+    CHECK( contains(&errs, "inserting implicit <body>") );
+    CHECK( tidyWarningCount(tdoc) == 2 );
+
+    /* without show-warnings the warnings never reach the filter */
+    records = 0;
+    tidyOptSetBool( tdoc, TidyShowWarnings, no );
+    memset( &repeated, 0, sizeof(repeated) );
+    CHECK( tidyParseString(tdoc, "<p>x <img src=a.png width=1 width=2 alt=x>") >= 0 );
+    CHECK( repeated.code == 0 );
+    CHECK( records == 0 );
+
+    tidyBufFree( &errs );
+    tidyRelease( tdoc );
+}
+
+static void testConfigProfile( void )
+{
+    TidyDoc from = tidyCreate();
+    TidyDoc to = tidyCreate();
+    TidyConfigProfile profile;
+    TidyBuffer out, errs;
+
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    tidyOptSetBool( from, TidyXhtmlOut, yes );
+    tidyOptSetInt( from, TidyWrapLen, 40 );
+    tidyOptSetValue( from, TidyAltText, "picture" );
+    tidyOptSetValue( from, TidyBlockTags, "widget" );
+    profile = tidyCreateConfigProfile( from );
+    CHECK( profile != NULL );
+
+    /* the profile outlives the document it was made from, and later
+       changes to that document do not reach it */
+    tidyOptSetValue( from, TidyAltText, "changed" );
+    tidyRelease( from );
+
+    CHECK( tidyApplyConfigProfile(to, profile) );
+    CHECK( tidyOptGetBool(to, TidyXhtmlOut) );
+    CHECK( tidyOptGetInt(to, TidyWrapLen) == 40 );
+    CHECK( tidyOptGetValue(to, TidyAltText) != NULL &&
+           strcmp(tidyOptGetValue(to, TidyAltText), "picture") == 0 );
+    CHECK( tidyOptGetValue(to, TidyBlockTags) != NULL &&
+           strstr(tidyOptGetValue(to, TidyBlockTags), "widget") != NULL );
+
+    /* the declared tag is known to the document it was applied to */
+    tidySetErrorBuffer( to, &errs );
+    CHECK( tidyParseString(to, "<widget>x</widget><img src=a.png>") >= 0 );
+    CHECK( tidySaveBuffer(to, &out) >= 0 );
+    CHECK( contains(&out, "<widget>") && contains(&out, "alt=\"picture\"") );
+    CHECK( !contains(&errs, "is not recognized") );
+
+    tidyRelease( to );
+    tidyReleaseConfigProfile( profile );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+}
+
+static void testReset( void )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer out, errs;
+
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    tidyOptSetBool( tdoc, TidyXhtmlOut, yes );
+    CHECK( tidyParseString(tdoc, "<p>one<b>two</p><foo>") == 2 );
+    CHECK( tidyWarningCount(tdoc) > 0 && tidyErrorCount(tdoc) > 0 );
+    CHECK( tidyStatus(tdoc) == 2 );
+
+    /* counts, status and tree go, the configuration stays */
+    tidyReset( tdoc );
+    CHECK( tidyWarningCount(tdoc) == 0 );
+    CHECK( tidyErrorCount(tdoc) == 0 );
+    CHECK( tidyAccessWarningCount(tdoc) == 0 );
+    CHECK( tidyStatus(tdoc) == 0 );
+    CHECK( tidyGetChild(tidyGetRoot(tdoc)) == NULL );
+    CHECK( tidyOptGetBool(tdoc, TidyXhtmlOut) );
+
+    CHECK( tidyParseString(tdoc, "<!DOCTYPE html><title>t</title><p>br<br>") >= 0 );
+    CHECK( tidySaveBuffer(tdoc, &out) >= 0 );
+    CHECK( contains(&out, "<br />") );
+
+    tidyRelease( tdoc );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+}
+
+static void testStats( void )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer out, errs;
+    TidyStats stats, after;
+
+    tidyBufInit( &out );
+    tidyBufInit( &errs );
+    tidySetErrorBuffer( tdoc, &errs );
+    CHECK( tidyGetStats(tdoc, NULL) == -EINVAL );
+
+    CHECK( tidyParseString(tdoc, cancelDoc) >= 0 );
+    CHECK( tidyCleanAndRepair(tdoc) >= 0 );
+    CHECK( tidySaveBuffer(tdoc, &out) >= 0 );
+    CHECK( tidyGetStats(tdoc, &stats) == 0 );
+    CHECK( stats.nodes > 0 && stats.attributes > 0 );
+    CHECK( stats.maxDepth >= 3 );
+    CHECK( stats.lexbufSize > 0 && stats.printBufSize > 0 );
+    CHECK( stats.allocCount > 0 && stats.allocBytes > 0 );
+
+    /* the next parse starts from zero: nothing printed yet, and only
+       what the smaller document needed */
+    CHECK( tidyParseString(tdoc, "<p>x") >= 0 );
+    CHECK( tidyGetStats(tdoc, &after) == 0 );
+    CHECK( after.wallTime[TidyPhase_Print] == 0 );
+    CHECK( after.cpuTime[TidyPhase_Print] == 0 );
+    CHECK( after.wallTime[TidyPhase_CleanRepair] == 0 );
+    CHECK( after.nodes > 0 && after.nodes < stats.nodes );
+    CHECK( after.attributes == 0 );
+    CHECK( after.allocCount > 0 && after.allocCount < stats.allocCount );
+    CHECK( after.allocBytes < stats.allocBytes );
+
+    tidyRelease( tdoc );
+    tidyBufFree( &out );
+    tidyBufFree( &errs );
+}
+
+int main( int argc, char** argv )
+{
+    testFragment();
+    testCancel();
+    testTokenize();
+    testNodesByTagId();
+    testSave();
+    testReportFilters();
+    testRecordFilter();
+    testConfigProfile();
+    testReset();
+    testStats();
+
+    if ( failures )
+        fprintf( stderr, "%d check(s) failed\n", failures );
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#! /bin/sh
+
+#
+# testserve.sh - check the request and response frames of tidy -serve
+#
+# (c) 1998-2006 (W3C) MIT, ERCIM, Keio University
+# See tidy.c for the copyright notice.
+#
+# <URL:http://www.html-tidy.org/>
+#
+# Usage: testserve.sh [path/to/tidy]
+#
+BN=`basename $0`
+
+TIDY=${1:-../build/cmake/tidy}
+if [ ! -f "$TIDY" ]; then
+	echo "$BN: Can NOT locate binary '$TIDY'!"
+	exit 1
+fi
+
+LC_ALL=C
+export LC_ALL
+TMP=${TMPDIR:-/tmp}/testserve.$$
+mkdir -p "$TMP" || exit 1
+trap 'rm -rf "$TMP"' 0
+FAILED=0
+
+# fail MESSAGE - note a failed check
+fail() {
+	echo "$BN: $1"
+	FAILED=`expr $FAILED + 1`
+}
+
+# len N - N as 4 bytes, most significant first
+len() {
+	printf "\\`printf %03o $(( ($1 >> 24) & 255 ))`"
+	printf "\\`printf %03o $(( ($1 >> 16) & 255 ))`"
+	printf "\\`printf %03o $(( ($1 >> 8) & 255 ))`"
+	printf "\\`printf %03o $(( $1 & 255 ))`"
+}
+
+# frame TEXT - the length of TEXT and TEXT
+frame() {
+	len ${#1}
+	printf '%s' "$1"
+}
+
+# num FILE OFFSET - the 4 byte number at OFFSET in FILE
+num() {
+	set -- `od -An -tu1 -j $2 -N 4 "$1"`
+	echo $(( ($1 << 24) | ($2 << 16) | ($3 << 8) | $4 ))
+}
+
+# part FILE OFFSET N - N bytes of FILE from OFFSET
+part() {
+	dd if="$1" bs=1 skip=$2 count=$3 2>/dev/null
+}
+
+# response FILE OFFSET - sets STATUS, OUT and MSG from the response at
+# OFFSET in FILE, and NEXT to the offset after it
+response() {
+	STATUS=`num "$1" $2`
+	OUTLEN=`num "$1" $(( $2 + 4 ))`
+	OUT=`part "$1" $(( $2 + 8 )) $OUTLEN`
+	MSGLEN=`num "$1" $(( $2 + 8 + OUTLEN ))`
+	MSG=`part "$1" $(( $2 + 12 + OUTLEN )) $MSGLEN`
+	NEXT=$(( $2 + 12 + OUTLEN + MSGLEN ))
+}
+
+# serve a stream of requests, answered one after the other
+printf 'tidy-mark: no\n' > "$TMP/good.cfg"
+printf 'no-such-option: yes\n' > "$TMP/bad.cfg"
+{
+	frame "show-body-only: yes"
+	frame "<p>one"
+	frame "config: $TMP/good.cfg"
+	frame "<!DOCTYPE html><title>t</title><body><p>two"
+	frame "config: $TMP/bad.cfg"
+	frame "<p>three"
+	frame "config: $TMP/missing.cfg"
+	frame "<p>four"
+} > "$TMP/requests"
+"$TIDY" -serve < "$TMP/requests" > "$TMP/responses" 2> "$TMP/errors"
+[ $? -eq 0 ] || fail "a good stream of requests did not end with 0"
+[ -s "$TMP/errors" ] && fail "the server wrote to stderr: `cat "$TMP/errors"`"
+
+response "$TMP/responses" 0
+[ "$OUT" = "<p>one</p>" ] || fail "unexpected output '$OUT'"
+response "$TMP/responses" $NEXT
+[ "$STATUS" -eq 0 ] || fail "unexpected status $STATUS with a config file"
+case "$OUT" in
+	*generator*) fail "the config file was not applied" ;;
+	*"<p>two</p>"*) ;;
+	*) fail "unexpected output '$OUT'" ;;
+esac
+response "$TMP/responses" $NEXT
+case "$MSG" in
+	*no-such-option*) ;;
+	*) fail "a bad config file is not reported with the request" ;;
+esac
+response "$TMP/responses" $NEXT
+case "$MSG" in
+	*missing.cfg*) ;;
+	*) fail "a missing config file is not reported with the request" ;;
+esac
+[ $NEXT -eq `wc -c < "$TMP/responses"` ] || fail "more responses than requests"
+
+# a length far beyond the bytes sent ends the stream without an answer
+{
+	frame ""
+	printf '\377\377\377\377<p>short'
+} | "$TIDY" -serve > "$TMP/responses" 2> /dev/null
+STATUS=$?
+[ $STATUS -eq 2 ] || fail "a huge frame length gave exit status $STATUS"
+[ -s "$TMP/responses" ] && fail "a huge frame length was answered"
+
+# so does a frame longer than max-input-size
+{
+	frame ""
+	frame "<p>0123456789"
+} | "$TIDY" --max-input-size 12 -serve > "$TMP/responses" 2> /dev/null
+STATUS=$?
+[ $STATUS -eq 2 ] || fail "a frame past max-input-size gave exit status $STATUS"
+[ -s "$TMP/responses" ] && fail "a frame past max-input-size was answered"
+
+# and a short frame
+{
+	frame ""
+	len 100
+	printf '<p>short'
+} | "$TIDY" -serve > "$TMP/responses" 2> /dev/null
+STATUS=$?
+[ $STATUS -eq 2 ] || fail "a short frame gave exit status $STATUS"
+
+if [ $FAILED -ne 0 ]; then
+	echo "$BN: $FAILED check(s) failed"
+	exit 1
+fi
+exit 0